@@ -0,0 +1,833 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Benchmarks for the hot paths of midilib: parsing, multiplexing and visiting.
+/// All benchmarks run on synthetic midi data, see synthetic_midi.hpp. Results are reported as text, or as one json
+/// object per line (--json) so that they can be collected and compared over releases.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm> // for sort, min
+#include <cstdlib> // for atoi, atof, exit, rand
+#include <cstring> // for strcmp, memcpy
+#include <memory_resource>
+
+#if defined( __unix__) || defined( __APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_multiplexer.hpp"
+#include "midilib/include/midi_writer.hpp"
+#include "midilib/include/event_queue.hpp"
+#include "midilib/include/simd_scan.hpp"
+#include "midilib/include/midi_validator.hpp"
+#include "midilib/include/wire_decoder.hpp"
+#include "midilib/include/note_spans.hpp"
+#include "midilib/include/shared_midi_file.hpp"
+#include "midilib/include/midi_event_visitor.hpp"
+#include "midilib/include/timed_midi_visitor.hpp"
+#include "midilib/include/packed_midi_file.hpp"
+#include "synthetic_midi.hpp"
+
+namespace
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    /// results of the visitors end up here, so that the compiler can't optimize the visits away.
+    volatile double sink;
+
+    double seconds_since( clock_type::time_point start)
+    {
+        return std::chrono::duration<double>( clock_type::now() - start).count();
+    }
+
+    /// peak resident set size of this process in kilobytes, or zero if that can't be determined on this platform.
+    long peak_rss_kb()
+    {
+#if defined( __unix__) || defined( __APPLE__)
+        rusage usage;
+        if (getrusage( RUSAGE_SELF, &usage) == 0)
+        {
+#if defined( __APPLE__)
+            return usage.ru_maxrss / 1024;
+#else
+            return usage.ru_maxrss;
+#endif
+        }
+#endif
+        return 0;
+    }
+
+    /// Settings of a benchmark run.
+    struct bench_options
+    {
+        bench_options()
+            : min_seconds( 0.5), json( false), scaling( true)
+        {
+        }
+
+        synthetic_midi_options  file;
+        double                  min_seconds;    ///< minimum duration of each measurement.
+        bool                    json;           ///< report as json lines instead of text.
+        bool                    scaling;        ///< also run the multiplexer scaling benchmark.
+    };
+
+    /// the result of one benchmark.
+    struct measurement
+    {
+        measurement( const std::string &name, unsigned tracks)
+            : name( name), tracks( tracks), runs( 0), seconds( 0), events( 0), bytes( 0), memory( 0)
+        {
+        }
+
+        std::string name;
+        unsigned    tracks;
+        unsigned    runs;
+        double      seconds;
+        size_t      events; ///< total number of events processed over all runs.
+        size_t      bytes;  ///< total number of input bytes processed over all runs.
+        size_t      memory; ///< bytes held by the data structure that was measured, zero if not reported.
+    };
+
+    void report( const measurement &m, const bench_options &options)
+    {
+        const double events_per_second = m.events / m.seconds;
+        const double bytes_per_second = m.bytes / m.seconds;
+        if (options.json)
+        {
+            std::cout << "{\"benchmark\":\"" << m.name << "\""
+                << ",\"tracks\":" << m.tracks
+                << ",\"runs\":" << m.runs
+                << ",\"seconds\":" << m.seconds
+                << ",\"events_per_second\":" << events_per_second
+                << ",\"bytes_per_second\":" << bytes_per_second
+                << ",\"peak_rss_kb\":" << peak_rss_kb();
+            if (m.memory) std::cout << ",\"memory_bytes\":" << m.memory;
+            std::cout << "}\n";
+        }
+        else
+        {
+            std::cout << m.name
+                << " tracks=" << m.tracks
+                << " runs=" << m.runs
+                << " ns/event=" << (m.events ? m.seconds * 1e9 / m.events : 0)
+                << " events/s=" << events_per_second
+                << " MB/s=" << bytes_per_second / (1024 * 1024)
+                << " peak_rss_kb=" << peak_rss_kb();
+            if (m.memory) std::cout << " memory_kb=" << m.memory / 1024;
+            std::cout << '\n';
+        }
+    }
+
+    /// run 'function' repeatedly until at least min_seconds have passed. function must return the number of events
+    /// it processed.
+    template<typename Function>
+    void measure( measurement &m, size_t bytes_per_run, double min_seconds, Function function)
+    {
+        const clock_type::time_point start = clock_type::now();
+        do
+        {
+            m.events += function();
+            m.bytes += bytes_per_run;
+            ++m.runs;
+        } while (seconds_since( start) < min_seconds);
+        m.seconds = seconds_since( start);
+    }
+
+    size_t count_events( const midi_file &file)
+    {
+        size_t count = 0;
+        for (midi_file::tracks_type::const_iterator i = file.tracks.begin(); i != file.tracks.end(); ++i)
+        {
+            count += i->size();
+        }
+        return count;
+    }
+
+    /// the number of bytes allocated for the tracks, events, meta event data and sysex payloads of a file, the
+    /// counterpart of packed_midi_file::memory_usage().
+    size_t memory_usage( const midi_file &file)
+    {
+        size_t result = file.tracks.capacity() * sizeof( midi_track) + file.sysex_data.capacity();
+        for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+        {
+            result += track->capacity() * sizeof( events::timed_midi_event);
+            for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+            {
+                if (const events::meta *meta = boost::get<events::meta>( &event->event))
+                {
+                    result += meta->bytes.capacity();
+                }
+            }
+        }
+        return result;
+    }
+
+    /// visitor that counts all events and sums their delta times, so that the work can't be optimized away.
+    struct counting_visitor : public events::visitor<counting_visitor>
+    {
+        using events::visitor<counting_visitor>::operator();
+
+        counting_visitor()
+            : count( 0), total_time( 0)
+        {
+        }
+
+        void operator()( const events::timed_midi_event &event)
+        {
+            ++count;
+            total_time += event.delta_time;
+        }
+
+        void operator()( const events::timed_midi_event_ref &event)
+        {
+            ++count;
+            total_time += event.delta_time;
+        }
+
+        size_t count;
+        size_t total_time;
+    };
+
+    /// timed visitor that counts note-on events, to measure the cost of timekeeping and event dispatch.
+    struct note_counting_visitor : public events::timed_visitor<note_counting_visitor>
+    {
+        typedef events::timed_visitor<note_counting_visitor> parent;
+        using parent::operator();
+
+        explicit note_counting_visitor( const midi_header &header)
+            : parent( header), notes( 0), events( 0)
+        {
+        }
+
+        void operator()( const events::timed_midi_event &event)
+        {
+            ++events;
+            parent::operator()( event);
+        }
+
+        void operator()( const events::note_on &)
+        {
+            ++notes;
+        }
+
+        double time() const
+        {
+            return get_current_time();
+        }
+
+        size_t notes;
+        size_t events;
+    };
+
+    void bench_parser( const std::string &name, const std::vector<unsigned char> &bytes, const parse_options &parser_options, const bench_options &options)
+    {
+        measurement m( name, options.file.tracks);
+        midi_file file;
+        measure( m, bytes.size(), options.min_seconds,
+            [&]()
+            {
+                if (!parse_midifile( &bytes[0], bytes.size(), file, parser_options))
+                {
+                    std::cerr << name << ": could not parse the synthetic file\n";
+                    std::exit( -1);
+                }
+                return count_events( file);
+            });
+        report( m, options);
+    }
+
+    /// measure validate_midifile, with and without checking the events. Event counts are the number of chunks
+    /// respectively events that were found, compare these with memcpy on bytes/s.
+    void bench_validator( const std::vector<unsigned char> &bytes, const bench_options &options)
+    {
+        std::vector<unsigned char> copy( bytes.size());
+        measurement copying( "memcpy", options.file.tracks);
+        measure( copying, bytes.size(), options.min_seconds,
+            [&]()
+            {
+                std::memcpy( &copy[0], &bytes[0], bytes.size());
+                sink = sink + copy[bytes.size() / 2];
+                return size_t( 1);
+            });
+        report( copying, options);
+
+        for (int check_events = 0; check_events != 2; ++check_events)
+        {
+            measurement m( check_events ? "validate_events" : "validate_chunks", options.file.tracks);
+            measure( m, bytes.size(), options.min_seconds,
+                [&]()
+                {
+                    const midi_validation validation = validate_midifile( &bytes[0], bytes.size(), check_events != 0);
+                    if (!validation.valid())
+                    {
+                        std::cerr << m.name << ": the synthetic file is not valid\n";
+                        std::exit( -1);
+                    }
+                    size_t found = 0;
+                    for (midi_validation::chunks_type::const_iterator chunk = validation.chunks.begin(); chunk != validation.chunks.end(); ++chunk)
+                    {
+                        found += check_events ? chunk->events : 1;
+                    }
+                    return found;
+                });
+            report( m, options);
+        }
+    }
+
+    /// like bench_parser, but every run parses into a fresh monotonic arena that is released in one go.
+    void bench_arena_parser( const std::string &name, const std::vector<unsigned char> &bytes, const parse_options &parser_options, const bench_options &options)
+    {
+        measurement m( name, options.file.tracks);
+        measure( m, bytes.size(), options.min_seconds,
+            [&]()
+            {
+                std::pmr::monotonic_buffer_resource arena( 2 * bytes.size());
+                midi_file file( &arena);
+                if (!parse_midifile( &bytes[0], bytes.size(), file, parser_options))
+                {
+                    std::cerr << name << ": could not parse the synthetic file\n";
+                    std::exit( -1);
+                }
+                return count_events( file);
+            });
+        report( m, options);
+    }
+
+    void bench_multiplexer( const std::string &name, const midi_file &file, size_t bytes, const bench_options &options)
+    {
+        measurement m( name, static_cast<unsigned>( file.tracks.size()));
+        measure( m, bytes, options.min_seconds,
+            [&]()
+            {
+                counting_visitor visitor;
+                midi_multiplexer multiplexer( file.tracks);
+                multiplexer.accept( visitor);
+                return visitor.count;
+            });
+        report( m, options);
+    }
+
+    /// measure walking through a shared file with a cursor, compare with the multiplexer.
+    void bench_cursor( const midi_file &file, size_t bytes, const bench_options &options)
+    {
+        const shared_midi_file::pointer shared = shared_midi_file::create( midi_file( file));
+        measurement m( "cursor", static_cast<unsigned>( file.tracks.size()));
+        measure( m, bytes, options.min_seconds,
+            [&]()
+            {
+                size_t events = 0;
+                for (midi_cursor cursor = shared->cursor(); !cursor.at_end(); ++events)
+                {
+                    sink = sink + cursor.next().delta_time;
+                }
+                return events;
+            });
+        report( m, options);
+    }
+
+    void bench_timed_visitor( const midi_file &file, size_t bytes, const bench_options &options)
+    {
+        measurement m( "timed_visitor", static_cast<unsigned>( file.tracks.size()));
+        measure( m, bytes, options.min_seconds,
+            [&]()
+            {
+                size_t events = 0;
+                for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+                {
+                    note_counting_visitor visitor( file.header);
+                    for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+                    {
+                        visitor( *event);
+                    }
+                    events += visitor.events;
+                    sink = sink + visitor.time() + visitor.notes;
+                }
+                return events;
+            });
+        report( m, options);
+    }
+
+    /// measure visiting all events track by track, in a midi_file and in a packed copy of it. Both report the memory
+    /// that their tracks take.
+    void bench_track_iteration( const midi_file &file, size_t bytes, const bench_options &options)
+    {
+        measurement unpacked( "iterate_tracks", static_cast<unsigned>( file.tracks.size()));
+        unpacked.memory = memory_usage( file);
+        measure( unpacked, bytes, options.min_seconds,
+            [&]()
+            {
+                counting_visitor visitor;
+                for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+                {
+                    for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+                    {
+                        visitor( *event);
+                    }
+                }
+                sink = sink + visitor.total_time;
+                return visitor.count;
+            });
+        report( unpacked, options);
+
+        const packed_midi_file packed_file( file);
+        measurement packed( "iterate_packed", static_cast<unsigned>( file.tracks.size()));
+        packed.memory = packed_file.memory_usage();
+        measure( packed, bytes, options.min_seconds,
+            [&]()
+            {
+                counting_visitor visitor;
+                for (packed_midi_file::tracks_type::const_iterator track = packed_file.tracks.begin(); track != packed_file.tracks.end(); ++track)
+                {
+                    for (packed_midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+                    {
+                        visitor( *event);
+                    }
+                }
+                sink = sink + visitor.total_time;
+                return visitor.count;
+            });
+        report( packed, options);
+    }
+
+    /// measure how fast a midi_file is written back as a standard midi file. The output buffer is reused, as it would
+    /// be when writing many files. bytes/s refers to the written bytes.
+    void bench_writer( const midi_file &file, const bench_options &options)
+    {
+        std::vector<unsigned char> buffer;
+        write_midifile( file, buffer);
+
+        measurement m( "write_smf", static_cast<unsigned>( file.tracks.size()));
+        measure( m, buffer.size(), options.min_seconds,
+            [&]()
+            {
+                write_midifile( file, buffer);
+                sink = sink + buffer[buffer.size() - 1];
+                return count_events( file);
+            });
+        report( m, options);
+    }
+
+    /// measure the throughput of an event_pipeline: the file is multiplexed on a producer thread and the events are
+    /// consumed on this thread.
+    void bench_pipeline( const midi_file &file, size_t bytes, const bench_options &options)
+    {
+        measurement m( "pipeline", static_cast<unsigned>( file.tracks.size()));
+        measure( m, bytes, options.min_seconds,
+            [&]()
+            {
+                event_pipeline pipeline( file);
+                compact_event event;
+                size_t count = 0;
+                while (pipeline.next( event))
+                {
+                    ++count;
+                    sink = sink + event.data1;
+                }
+                return count;
+            });
+        report( m, options);
+    }
+
+    /// measure extracting the notes of a file and querying them, the way a visualizer would every frame: 1000
+    /// windows of one quarter note at random times. For queries, event counts are the number of notes found.
+    void bench_note_spans( const midi_file &file, const bench_options &options)
+    {
+        note_span_vector notes;
+        measurement extraction( "note_spans", static_cast<unsigned>( file.tracks.size()));
+        measure( extraction, 0, options.min_seconds,
+            [&]()
+            {
+                extract_note_spans( file, notes);
+                return notes.size();
+            });
+        report( extraction, options);
+
+        const note_span_index index( notes);
+        note_span::tick_type length = 1;
+        for (note_span_vector::const_iterator note = notes.begin(); note != notes.end(); ++note)
+        {
+            length = std::max( length, note->end);
+        }
+
+        std::vector<note_span::tick_type> windows( 1000);
+        for (size_t window = 0; window != windows.size(); ++window)
+        {
+            windows[window] = std::rand() % length;
+        }
+
+        measurement queries( "note_query", static_cast<unsigned>( file.tracks.size()));
+        measure( queries, 0, options.min_seconds,
+            [&]()
+            {
+                size_t found = 0;
+                for (size_t window = 0; window != windows.size(); ++window)
+                {
+                    index.query( windows[window], windows[window] + file.header.division,
+                        [&found]( const note_span &) { ++found; });
+                }
+                return found;
+            });
+        report( queries, options);
+    }
+
+    /// report the median, 99th and 99.9th percentile and maximum of the given latencies in clock ticks.
+    /// Nothing is reported if there are no latencies.
+    void report_latencies( const std::string &name, double items_per_second, std::vector<clock_type::rep> &latencies, const bench_options &options)
+    {
+        const size_t items = latencies.size();
+        if (items == 0) return;
+
+        std::sort( latencies.begin(), latencies.end());
+        const double to_ns = 1e9 * clock_type::period::num / clock_type::period::den;
+        const double p50 = latencies[items / 2] * to_ns;
+        const double p99 = latencies[items - items / 100 - 1] * to_ns;
+        const double p999 = latencies[items - items / 1000 - 1] * to_ns;
+        const double max = latencies.back() * to_ns;
+        if (options.json)
+        {
+            std::cout << "{\"benchmark\":\"" << name << "\""
+                << ",\"items_per_second\":" << items_per_second
+                << ",\"p50_ns\":" << p50
+                << ",\"p99_ns\":" << p99
+                << ",\"p999_ns\":" << p999
+                << ",\"max_ns\":" << max
+                << "}\n";
+        }
+        else
+        {
+            std::cout << name
+                << " items/s=" << items_per_second
+                << " p50_ns=" << p50
+                << " p99_ns=" << p99
+                << " p999_ns=" << p999
+                << " max_ns=" << max
+                << '\n';
+        }
+    }
+
+    /// measure the latency of handing items from one thread to another through an spsc_ring.
+    /// The producer pushes time stamps as fast as the queue accepts them, the consumer records the time between the
+    /// push and the pop of every item. Reports percentiles of that latency.
+    void bench_queue_latency( const bench_options &options)
+    {
+        typedef clock_type::rep stamp_type;
+        const size_t items = 1000000;
+        spsc_ring<stamp_type> ring( 1024);
+
+        std::thread producer(
+            [&]()
+            {
+                for (size_t item = 0; item != items; ++item)
+                {
+                    ring.push( clock_type::now().time_since_epoch().count());
+                }
+            });
+
+        std::vector<stamp_type> latencies;
+        latencies.reserve( items);
+        const clock_type::time_point start = clock_type::now();
+        for (size_t item = 0; item != items; ++item)
+        {
+            stamp_type pushed;
+            ring.pop( pushed);
+            latencies.push_back( clock_type::now().time_since_epoch().count() - pushed);
+        }
+        const double seconds = seconds_since( start);
+        producer.join();
+
+        report_latencies( "queue_latency", items / seconds, latencies, options);
+    }
+
+    /// Handler for the wire decoder that counts messages and, if asked to, records the time since 'arrival' for
+    /// every channel message.
+    struct wire_latency_recorder
+    {
+        wire_latency_recorder( std::vector<clock_type::rep> *latencies)
+            : messages( 0), latencies( latencies)
+        {
+        }
+
+        void channel_event( const events::channel_event &)
+        {
+            ++messages;
+            if (latencies) latencies->push_back( (clock_type::now() - arrival).count());
+        }
+
+        void sysex_event( const events::sysex &, decoding::byte_iterator)
+        {
+            ++messages;
+        }
+
+        void system_common_event( unsigned char, unsigned char, unsigned char)
+        {
+            ++messages;
+        }
+
+        void realtime_event( unsigned char)
+        {
+            ++messages;
+        }
+
+        size_t                      messages;
+        clock_type::time_point      arrival;
+        std::vector<clock_type::rep> *latencies;
+    };
+
+    /// measure the wire decoder on the channel events of the file, sent with running status, with a sysex message
+    /// after every 256 events and a timing clock byte after every 32 bytes.
+    /// First the complete stream is decoded in one go. Then it is fed in chunks of random sizes up to 64 bytes, as
+    /// reads from a pipe would deliver it, and the time from the arrival of a chunk to the callback is recorded for
+    /// every channel message.
+    void bench_wire_decoder( const midi_file &file, const bench_options &options)
+    {
+        std::vector<unsigned char> wire;
+        unsigned char running_status = 0;
+        size_t events = 0;
+        size_t since_clock = 0;
+        const auto send = [&]( unsigned char byte)
+            {
+                wire.push_back( byte);
+                if (++since_clock == 32)
+                {
+                    wire.push_back( 0xf8);
+                    since_clock = 0;
+                }
+            };
+        for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+        {
+            for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+            {
+                if (const events::channel_event *channel = boost::get<events::channel_event>( &event->event))
+                {
+                    unsigned char status, data1, data2;
+                    decoding::split_channel_event( *channel, status, data1, data2);
+                    if (status != running_status) send( status);
+                    running_status = status;
+                    send( data1);
+                    if (decoding::channel_event_length[ status >> 4] == 2) send( data2);
+
+                    if (++events % 256 == 0)
+                    {
+                        send( 0xf0);
+                        for (unsigned byte = 0; byte != 32; ++byte) send( byte);
+                        send( 0xf7);
+                        running_status = 0;
+                    }
+                }
+            }
+        }
+
+        {
+            measurement m( "wire_decode", static_cast<unsigned>( file.tracks.size()));
+            wire_latency_recorder recorder( 0);
+            decoding::wire_decoder<wire_latency_recorder> decoder( recorder);
+            measure( m, wire.size(), options.min_seconds,
+                [&]()
+                {
+                    recorder.messages = 0;
+                    decoder.decode( &wire[0], &wire[0] + wire.size());
+                    return recorder.messages;
+                });
+            report( m, options);
+        }
+
+        std::vector<clock_type::rep> latencies;
+        latencies.reserve( events);
+        wire_latency_recorder recorder( &latencies);
+        decoding::wire_decoder<wire_latency_recorder> decoder( recorder);
+        const clock_type::time_point start = clock_type::now();
+        for (size_t offset = 0; offset < wire.size(); )
+        {
+            const size_t chunk = std::min<size_t>( 1 + std::rand() % 64, wire.size() - offset);
+            recorder.arrival = clock_type::now();
+            decoder.decode( &wire[offset], &wire[offset] + chunk);
+            offset += chunk;
+        }
+        const double seconds = seconds_since( start);
+
+        report_latencies( "wire_latency", latencies.size() / seconds, latencies, options);
+    }
+
+    /// measure bulk decoding of variable length quantities with every instruction set that this processor supports.
+    /// The input consists of the delta times of all events in the file, encoded back to back.
+    void bench_vlq_decoding( const midi_file &file, const bench_options &options)
+    {
+        using namespace decoding::simd;
+
+        std::vector<unsigned char> encoded;
+        for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+        {
+            for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+            {
+                synthetic::append_variable_length_quantity( encoded, event->delta_time);
+            }
+        }
+        std::vector<boost::uint32_t> decoded( count_events( file));
+
+        for (int instructions = scalar_instructions; instructions <= best_instruction_set(); ++instructions)
+        {
+            measurement m( std::string( "vlq_decode_") + instruction_set_name( instruction_set( instructions)), static_cast<unsigned>( file.tracks.size()));
+            measure( m, encoded.size(), options.min_seconds,
+                [&]()
+                {
+                    byte_iterator end;
+                    const size_t count = decode_variable_length_quantities(
+                        &encoded[0], &encoded[0] + encoded.size(), &decoded[0], decoded.size(), end, instruction_set( instructions));
+                    sink = sink + decoded[count - 1];
+                    return count;
+                });
+            report( m, options);
+        }
+    }
+
+    /// measure how fast track chunk headers are found in a concatenation of files, with every instruction set that
+    /// this processor supports. Events counts are the number of chunks found.
+    void bench_chunk_scan( const std::vector<unsigned char> &bytes, const bench_options &options)
+    {
+        using namespace decoding::simd;
+
+        std::vector<unsigned char> concatenated;
+        for (unsigned copy = 0; copy != 16; ++copy)
+        {
+            concatenated.insert( concatenated.end(), bytes.begin(), bytes.end());
+        }
+        const byte_iterator last = &concatenated[0] + concatenated.size();
+
+        for (int instructions = scalar_instructions; instructions <= best_instruction_set(); ++instructions)
+        {
+            measurement m( std::string( "chunk_scan_") + instruction_set_name( instruction_set( instructions)), options.file.tracks);
+            measure( m, concatenated.size(), options.min_seconds,
+                [&]()
+                {
+                    size_t chunks = 0;
+                    for (byte_iterator current = &concatenated[0];; ++current)
+                    {
+                        current = find_signature( current, last, "MTrk", instruction_set( instructions));
+                        if (current == last) break;
+                        ++chunks;
+                    }
+                    return chunks;
+                });
+            report( m, options);
+        }
+    }
+
+    /// measure how fast a midi_multiplexer merges files with increasing numbers of tracks.
+    /// The total number of events is kept constant, so that the results for different numbers of tracks can be
+    /// compared directly.
+    void bench_multiplexer_scaling( const bench_options &options)
+    {
+        const unsigned total_events = 1024 * 1024;
+        const unsigned track_counts[] = { 16, 128, 1024};
+        for (unsigned i = 0; i != sizeof track_counts/sizeof track_counts[0]; ++i)
+        {
+            synthetic_midi_options file_options = options.file;
+            file_options.tracks = track_counts[i];
+            file_options.events_per_track = total_events / track_counts[i];
+            const std::vector<unsigned char> bytes = make_synthetic_midi_bytes( file_options);
+            midi_file file;
+            decoding::decode_midifile( &bytes[0], bytes.size(), file);
+            bench_multiplexer( "multiplexer_scaling", file, bytes.size(), options);
+        }
+    }
+
+    void usage()
+    {
+        std::cerr <<
+            "usage: midilib_bench [options]\n"
+            "  --tracks <n>           number of tracks in the synthetic file (16)\n"
+            "  --events <n>           events per track (1000)\n"
+            "  --max-delta <n>        maximum delta time between events (96)\n"
+            "  --meta <fraction>      fraction of meta events (0.05)\n"
+            "  --sysex <fraction>     fraction of sysex events (0)\n"
+            "  --no-running-status    write a status byte for every channel event\n"
+            "  --seconds <s>          minimum duration of each measurement (0.5)\n"
+            "  --no-scaling           skip the multiplexer scaling benchmark\n"
+            "  --json                 report results as json lines\n";
+        std::exit( -1);
+    }
+
+    bench_options parse_arguments( int argc, char *argv[])
+    {
+        bench_options options;
+        for (int arg = 1; arg < argc; ++arg)
+        {
+            const bool has_value = arg + 1 < argc;
+            if (!std::strcmp( argv[arg], "--tracks") && has_value)          options.file.tracks = std::atoi( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--events") && has_value)     options.file.events_per_track = std::atoi( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--max-delta") && has_value)  options.file.max_delta_time = std::atoi( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--meta") && has_value)       options.file.meta_ratio = std::atof( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--sysex") && has_value)      options.file.sysex_ratio = std::atof( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--seconds") && has_value)    options.min_seconds = std::atof( argv[++arg]);
+            else if (!std::strcmp( argv[arg], "--no-running-status"))       options.file.running_status = false;
+            else if (!std::strcmp( argv[arg], "--no-scaling"))              options.scaling = false;
+            else if (!std::strcmp( argv[arg], "--json"))                    options.json = true;
+            else usage();
+        }
+
+        if (options.file.tracks == 0 || options.file.events_per_track == 0) usage();
+        return options;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const bench_options options = parse_arguments( argc, argv);
+
+    const std::vector<unsigned char> bytes = make_synthetic_midi_bytes( options.file);
+
+    bench_parser( "parse_spirit", bytes, parse_options( parse_options::spirit_backend), options);
+    bench_parser( "parse_table", bytes, parse_options( parse_options::table_backend), options);
+    bench_arena_parser( "parse_table_arena", bytes, parse_options( parse_options::table_backend), options);
+
+    bench_validator( bytes, options);
+
+    // every track is measured before it is built, compare with parse_table for the cost of that extra pass.
+    parse_options limited( parse_options::table_backend);
+    limited.limits = decode_limits::untrusted();
+    bench_parser( "parse_table_limited", bytes, limited, options);
+
+    parse_options parallel( parse_options::table_backend);
+    parallel.threads = 0;
+    bench_parser( "parse_parallel", bytes, parallel, options);
+
+    // only the meta events are counted, so compare this one with the others on bytes/s.
+    parse_options meta_only( parse_options::table_backend);
+    meta_only.filter = event_filter::meta_only();
+    bench_parser( "parse_meta_only", bytes, meta_only, options);
+
+    parse_options drum_notes( parse_options::table_backend);
+    drum_notes.filter = event_filter::channel( event_filter::note_events, 9);
+    bench_parser( "parse_drum_notes", bytes, drum_notes, options);
+
+    midi_file file;
+    decoding::decode_midifile( &bytes[0], bytes.size(), file);
+    bench_multiplexer( "multiplexer", file, bytes.size(), options);
+    bench_cursor( file, bytes.size(), options);
+    bench_timed_visitor( file, bytes.size(), options);
+    bench_track_iteration( file, bytes.size(), options);
+    bench_writer( file, options);
+    bench_pipeline( file, bytes.size(), options);
+    bench_queue_latency( options);
+    bench_wire_decoder( file, options);
+    bench_note_spans( file, options);
+    bench_vlq_decoding( file, options);
+    bench_chunk_scan( bytes, options);
+
+    if (options.scaling)
+    {
+        bench_multiplexer_scaling( options);
+    }
+
+    return 0;
+}
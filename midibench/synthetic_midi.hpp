@@ -0,0 +1,150 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a generator for synthetic midi files, to be used by the benchmarks.
+
+#if !defined( SYNTHETIC_MIDI_HPP)
+#define SYNTHETIC_MIDI_HPP
+#include <random>
+#include <vector>
+#include <cstddef> // for size_t
+#include "midilib/include/midi_file.hpp"
+#include "midilib/include/midi_decoder.hpp"
+
+/// Parameters of a synthetic midi file.
+struct synthetic_midi_options
+{
+    synthetic_midi_options()
+        : tracks( 16), events_per_track( 1000), max_delta_time( 96), meta_ratio( 0.05), sysex_ratio( 0.0),
+          running_status( true), seed( 42)
+    {
+    }
+
+    unsigned tracks;
+    unsigned events_per_track;
+    unsigned max_delta_time;    ///< delta times are uniformly distributed in [0, max_delta_time], this determines the event density.
+    double   meta_ratio;        ///< fraction of events that are (text) meta events.
+    double   sysex_ratio;       ///< fraction of events that are sysex events.
+    bool     running_status;    ///< whether to leave out repeated status bytes.
+    unsigned seed;
+};
+
+namespace synthetic
+{
+    inline void append_variable_length_quantity( std::vector<unsigned char> &out, size_t value)
+    {
+        unsigned char bytes[10];
+        size_t count = 0;
+        do
+        {
+            bytes[count++] = value & 0x7f;
+            value >>= 7;
+        } while (value);
+
+        while (count > 1)
+        {
+            out.push_back( bytes[--count] | 0x80);
+        }
+        out.push_back( bytes[0]);
+    }
+
+    inline void append_big_endian( std::vector<unsigned char> &out, unsigned value, unsigned bytes)
+    {
+        while (bytes--)
+        {
+            out.push_back( (value >> (8 * bytes)) & 0xff);
+        }
+    }
+}
+
+/// create the bytes of a format 1 midi file with pseudo-random events.
+/// Channel events are mostly note-on events (with alternating velocity 0 as note-off), mixed with some controller,
+/// program change and pitch bend events. Every track uses its own channel.
+inline std::vector<unsigned char> make_synthetic_midi_bytes( const synthetic_midi_options &options)
+{
+    using namespace synthetic;
+
+    std::mt19937 random( options.seed);
+    std::uniform_int_distribution<unsigned> delta( 0, options.max_delta_time);
+    std::uniform_int_distribution<unsigned> data_byte( 0, 127);
+    std::uniform_int_distribution<unsigned> payload_size( 8, 64);
+    std::uniform_real_distribution<double>  fraction( 0.0, 1.0);
+
+    std::vector<unsigned char> result;
+    const unsigned char header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6};
+    result.insert( result.end(), header, header + sizeof header);
+    append_big_endian( result, 1, 2);
+    append_big_endian( result, options.tracks, 2);
+    append_big_endian( result, 96, 2);
+
+    for (unsigned track = 0; track != options.tracks; ++track)
+    {
+        std::vector<unsigned char> data;
+        int running_status = -1;
+        for (unsigned index = 0; index != options.events_per_track; ++index)
+        {
+            append_variable_length_quantity( data, delta( random));
+
+            const double kind = fraction( random);
+            if (kind < options.meta_ratio)
+            {
+                data.push_back( 0xff);
+                data.push_back( 0x01);
+                const unsigned size = payload_size( random);
+                append_variable_length_quantity( data, size);
+                for (unsigned byte = 0; byte != size; ++byte) data.push_back( 'a' + byte % 26);
+            }
+            else if (kind < options.meta_ratio + options.sysex_ratio)
+            {
+                data.push_back( 0xf0);
+                const unsigned size = payload_size( random);
+                append_variable_length_quantity( data, size);
+                for (unsigned byte = 0; byte + 1 < size; ++byte) data.push_back( data_byte( random));
+                data.push_back( 0xf7);
+            }
+            else
+            {
+                unsigned char status = 0x90;
+                const unsigned other = data_byte( random);
+                if (other < 4) status = 0xb0;
+                else if (other < 5) status = 0xc0;
+                else if (other < 7) status = 0xe0;
+                status |= track % 16;
+
+                if (!options.running_status || status != running_status)
+                {
+                    data.push_back( status);
+                    running_status = status;
+                }
+                data.push_back( data_byte( random));
+                if (decoding::channel_event_length[ status >> 4] == 2)
+                {
+                    data.push_back( (status & 0xf0) == 0x90 ? ((index % 2) ? 0 : 64) : data_byte( random));
+                }
+            }
+        }
+
+        const unsigned char track_header[] = { 'M', 'T', 'r', 'k'};
+        result.insert( result.end(), track_header, track_header + sizeof track_header);
+        append_big_endian( result, static_cast<unsigned>( data.size()), 4);
+        result.insert( result.end(), data.begin(), data.end());
+    }
+
+    return result;
+}
+
+/// create a synthetic midi file in memory.
+inline midi_file make_synthetic_midi_file( const synthetic_midi_options &options)
+{
+    const std::vector<unsigned char> bytes = make_synthetic_midi_bytes( options);
+    midi_file result;
+    decoding::decode_midifile( &bytes[0], bytes.size(), result);
+    return result;
+}
+
+#endif //SYNTHETIC_MIDI_HPP
@@ -0,0 +1,99 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "include/event_queue.hpp"
+#include "include/midi_multiplexer.hpp"
+#include "include/midi_decoder.hpp"
+#include "include/tempo_map.hpp"
+
+namespace
+{
+    /// thrown by the queue writer to abandon the multiplexer when the pipeline is destroyed early.
+    struct pipeline_stopped
+    {
+    };
+
+    /// Visitor that converts the events offered by a multiplexer to compact events and pushes them on a queue.
+    struct queue_writer : boost::static_visitor<>
+    {
+        queue_writer( event_pipeline::queue_type &queue, const tempo_map &tempo, const std::atomic<bool> &stopping)
+            : queue( queue), tempo( tempo), stopping( stopping), source( 0), current()
+        {
+        }
+
+        void operator()( const events::timed_midi_event_ref &event)
+        {
+            source = &event.event;
+            current = compact_event();
+            current.tick = event.absolute_time;
+            current.microseconds = tempo.ticks_to_microseconds( event.absolute_time);
+            boost::apply_visitor( *this, event.event.event);
+            push( current);
+        }
+
+        void operator()( const events::channel_event &event)
+        {
+            decoding::split_channel_event( event, current.status, current.data1, current.data2);
+        }
+
+        void operator()( const events::meta &event)
+        {
+            current.status = 0xff;
+            current.data1 = event.type;
+            current.payload = source;
+        }
+
+        void operator()( const events::sysex &event)
+        {
+            current.status = event.status;
+            current.payload = source;
+        }
+
+        void push( const compact_event &event)
+        {
+            while (!queue.try_push( event))
+            {
+                if (stopping) throw pipeline_stopped();
+                std::this_thread::yield();
+            }
+        }
+
+        event_pipeline::queue_type      &queue;
+        const tempo_map                 &tempo;
+        const std::atomic<bool>         &stopping;
+        const events::timed_midi_event  *source;
+        compact_event                   current;
+    };
+}
+
+event_pipeline::event_pipeline( const midi_file &file, size_t capacity)
+    : queue( capacity), stopping( false), finished( false)
+{
+    producer = std::thread( &event_pipeline::produce, this, std::cref( file));
+}
+
+event_pipeline::~event_pipeline()
+{
+    stopping = true;
+    producer.join();
+}
+
+void event_pipeline::produce( const midi_file &file)
+{
+    const tempo_map tempo( file);
+    queue_writer writer( queue, tempo, stopping);
+    try
+    {
+        midi_multiplexer multiplexer( file.tracks);
+        multiplexer.accept( writer);
+        writer.push( compact_event::end_of_stream());
+    }
+    catch (const pipeline_stopped &)
+    {
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( DECODE_LIMITS_HPP)
+#define DECODE_LIMITS_HPP
+
+#include <cstddef> // for size_t
+#include <limits>
+
+/// Upper bounds on what a decoder may read from a single file, for input that can't be trusted.
+/// Without limits, memory use is proportional to the input size (lengths are always checked against the remaining
+/// input), but a small, well-formed file can still describe millions of events or a single huge meta event.
+/// With limits, every track is first measured without allocating anything. A file that exceeds any of the limits is
+/// rejected before its events are built. Input that is read from a stream is rejected as soon as it exceeds the
+/// maximum file size, before it is read completely.
+struct decode_limits
+{
+    /// create limits that accept everything.
+    decode_limits()
+        : max_file_size( std::numeric_limits<size_t>::max()),
+          max_quantity_bytes( std::numeric_limits<size_t>::max()),
+          max_payload_size( std::numeric_limits<size_t>::max()),
+          max_events_per_track( std::numeric_limits<size_t>::max()),
+          max_file_memory( std::numeric_limits<size_t>::max())
+    {
+    }
+
+    /// limits for files from unknown sources. The standard allows variable length quantities of at most four bytes,
+    /// the other values are far above what real files need.
+    static decode_limits untrusted()
+    {
+        decode_limits result;
+        result.max_file_size = 64 * 1024 * 1024;
+        result.max_quantity_bytes = 4;
+        result.max_payload_size = 1024 * 1024;
+        result.max_events_per_track = 4 * 1024 * 1024;
+        result.max_file_memory = 256 * 1024 * 1024;
+        return result;
+    }
+
+    bool unlimited() const
+    {
+        return
+                max_file_size == std::numeric_limits<size_t>::max()
+            &&  max_quantity_bytes == std::numeric_limits<size_t>::max()
+            &&  max_payload_size == std::numeric_limits<size_t>::max()
+            &&  max_events_per_track == std::numeric_limits<size_t>::max()
+            &&  max_file_memory == std::numeric_limits<size_t>::max();
+    }
+
+    size_t max_file_size;           ///< the maximum number of bytes in the file.
+    size_t max_quantity_bytes;      ///< the maximum number of bytes in a variable length quantity (delta times and lengths).
+    size_t max_payload_size;        ///< the maximum number of data bytes in a single meta or sysex event.
+    size_t max_events_per_track;    ///< the maximum number of events in a track chunk, before filtering.
+    size_t max_file_memory;         ///< the maximum number of bytes that the decoded events of a file may take.
+};
+
+#endif //DECODE_LIMITS_HPP
@@ -0,0 +1,105 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( EVENT_FILTER_HPP)
+#define EVENT_FILTER_HPP
+
+#include <bitset>
+
+/// A specification of the events that a parser should keep.
+/// An event is kept if its type is in the type mask and, for channel events, its channel is in the channel mask and,
+/// for meta events, its meta type is in the set of meta types.
+/// The decoder determines the length of every event, so rejected events are skipped without building event
+/// objects for them. Their delta times are added to the next kept event, so that kept events keep their absolute time.
+/// Time after the last kept event of a track is lost, see filtering_track_builder.
+struct event_filter
+{
+    /// bits of the type mask.
+    enum event_type
+    {
+        note_off_events             = 1 << 0,
+        note_on_events              = 1 << 1,
+        note_aftertouch_events      = 1 << 2,
+        controller_events           = 1 << 3,
+        program_change_events       = 1 << 4,
+        channel_aftertouch_events   = 1 << 5,
+        pitch_bend_events           = 1 << 6,
+        meta_events                 = 1 << 7,
+        sysex_events                = 1 << 8,
+
+        note_events                 = note_off_events | note_on_events,
+        channel_events              = 0x7f,
+        all_events                  = 0x1ff
+    };
+
+    typedef std::bitset<256> meta_type_set;
+
+    /// create a filter that accepts all events.
+    event_filter()
+        : types( all_events), channels( 0xffff)
+    {
+        meta_types.set();
+    }
+
+    /// create a filter that accepts the given event types on all channels and all meta types.
+    explicit event_filter( unsigned types)
+        : types( types), channels( 0xffff)
+    {
+        meta_types.set();
+    }
+
+    /// a filter that only accepts meta events, e.g. to extract lyrics or tempo information.
+    static event_filter meta_only()
+    {
+        return event_filter( meta_events);
+    }
+
+    /// a filter that only accepts meta events of a single type, e.g. 81 for tempo events.
+    static event_filter meta_only( unsigned char meta_type)
+    {
+        event_filter result( meta_events);
+        result.meta_types.reset();
+        result.meta_types.set( meta_type);
+        return result;
+    }
+
+    /// a filter that accepts the given channel events on a single channel (0-15).
+    static event_filter channel( unsigned types, unsigned channel_number)
+    {
+        event_filter result( types & channel_events);
+        result.channels = static_cast<unsigned short>( 1 << channel_number);
+        return result;
+    }
+
+    bool accepts_all() const
+    {
+        return (types & all_events) == all_events && channels == 0xffff && meta_types.all();
+    }
+
+    /// status is the status byte of a channel event, including the channel number.
+    bool accepts_channel_event( unsigned char status) const
+    {
+        return (types & (1u << ((status >> 4) - 8))) && (channels & (1u << (status & 0x0f)));
+    }
+
+    bool accepts_meta_event( unsigned char type) const
+    {
+        return (types & meta_events) && meta_types.test( type);
+    }
+
+    bool accepts_sysex_event() const
+    {
+        return (types & sysex_events) != 0;
+    }
+
+    unsigned        types;      ///< a combination of event_type bits.
+    unsigned short  channels;   ///< bit n is set if channel events on channel n (0-15) are accepted.
+    meta_type_set   meta_types; ///< the accepted meta event types.
+};
+
+#endif //EVENT_FILTER_HPP
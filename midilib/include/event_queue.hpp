@@ -0,0 +1,170 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a lock-free queue for handing midi events from one thread to another, and a pipeline that
+/// multiplexes a midi file on a thread of its own and offers the events through such a queue.
+
+#if !defined( EVENT_QUEUE_HPP)
+#define EVENT_QUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstddef> // for size_t
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+
+/// A bounded queue for exactly one producer thread and one consumer thread.
+/// The queue is a ring buffer with a power-of-two number of slots. The producer only writes the head index and the
+/// consumer only writes the tail index, so pushing and popping need no locks and no read-modify-write operations.
+/// Both sides keep a private copy of the other side's index and only reload it when the queue seems full or empty,
+/// so that the cache line of the other index is touched as little as possible.
+template<typename T>
+class spsc_ring
+{
+public:
+    /// create a ring with room for at least 'capacity' items.
+    explicit spsc_ring( size_t capacity)
+        : slots( round_up( capacity)), mask( slots.size() - 1), head( 0), cached_tail( 0), tail( 0), cached_head( 0)
+    {
+    }
+
+    size_t capacity() const
+    {
+        return slots.size();
+    }
+
+    /// add an item, if there is room. This may only be called by the producer thread.
+    bool try_push( const T &item)
+    {
+        const size_t current = head.load( std::memory_order_relaxed);
+        if (current - cached_tail == slots.size())
+        {
+            cached_tail = tail.load( std::memory_order_acquire);
+            if (current - cached_tail == slots.size()) return false;
+        }
+        slots[current & mask] = item;
+        head.store( current + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// remove the oldest item, if there is one. This may only be called by the consumer thread.
+    bool try_pop( T &item)
+    {
+        const size_t current = tail.load( std::memory_order_relaxed);
+        if (current == cached_head)
+        {
+            cached_head = head.load( std::memory_order_acquire);
+            if (current == cached_head) return false;
+        }
+        item = slots[current & mask];
+        tail.store( current + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// add an item, yielding the processor while the queue is full.
+    void push( const T &item)
+    {
+        while (!try_push( item))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    /// remove the oldest item, yielding the processor while the queue is empty.
+    void pop( T &item)
+    {
+        while (!try_pop( item))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    static const size_t cache_line_size = 64;
+
+    static size_t round_up( size_t capacity)
+    {
+        size_t result = 2;
+        while (result < capacity) result *= 2;
+        return result;
+    }
+
+    std::vector<T>  slots;
+    const size_t    mask;
+
+    // producer side: the index of the next slot to write and the last known tail.
+    alignas( cache_line_size) std::atomic<size_t>   head;
+    size_t                                          cached_tail;
+
+    // consumer side: the index of the next slot to read and the last known head.
+    alignas( cache_line_size) std::atomic<size_t>   tail;
+    size_t                                          cached_head;
+};
+
+/// A midi event in a form that can be copied cheaply between threads.
+/// Channel events are stored as their status byte and data bytes. Meta and sysex events refer to the event in the
+/// midi_file for their data, which therefore must outlive the consumer of these events.
+struct compact_event
+{
+    boost::uint64_t                 tick;           ///< absolute time in ticks.
+    boost::uint64_t                 microseconds;   ///< absolute time in microseconds, according to the tempo map.
+    const events::timed_midi_event  *payload;       ///< the original event for meta and sysex events, null otherwise.
+    unsigned char                   status;         ///< channel status byte, 0xff for meta, 0xf0 or 0xf7 for sysex.
+    unsigned char                   data1;          ///< first data byte of a channel event, or the meta type.
+    unsigned char                   data2;
+
+    /// the event that marks the end of a stream. This is the only event with a zero status byte.
+    static compact_event end_of_stream()
+    {
+        compact_event result = compact_event();
+        return result;
+    }
+
+    bool is_end_of_stream() const
+    {
+        return status == 0;
+    }
+};
+
+/// Multiplexes a midi file on a thread of its own and offers the events in chronological order as compact_events
+/// through an spsc_ring.
+/// The producer thread is started on construction. The consumer calls next() until it returns false. The midi file
+/// must outlive the pipeline and the compact events that were taken from it.
+class event_pipeline
+{
+public:
+    typedef spsc_ring<compact_event> queue_type;
+
+    explicit event_pipeline( const midi_file &file, size_t capacity = 4096);
+
+    /// stop the producer and wait for it to finish.
+    ~event_pipeline();
+
+    /// get the next event, waiting for the producer if necessary. Returns false if there are no more events.
+    bool next( compact_event &event)
+    {
+        if (finished) return false;
+        queue.pop( event);
+        finished = event.is_end_of_stream();
+        return !finished;
+    }
+
+private:
+    event_pipeline( const event_pipeline &);
+    event_pipeline &operator=( const event_pipeline &);
+
+    void produce( const midi_file &file);
+
+    queue_type          queue;
+    std::atomic<bool>   stopping;
+    bool                finished;
+    std::thread         producer;
+};
+
+#endif //EVENT_QUEUE_HPP
@@ -0,0 +1,531 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a hand-written, table driven decoder for midi files.
+/// It is an alternative to the spirit grammar in midi_parser.cpp that accepts exactly the same input, but dispatches
+/// channel events on the status nibble instead of trying every event type in turn.
+/// The decoding functions are templates on a handler type, so that the same decoder can be used to build midi_file
+/// structures or to feed events directly to some other consumer.
+
+#if !defined( MIDI_DECODER_HPP)
+#define MIDI_DECODER_HPP
+#include <cstddef> // for size_t
+#include <cstring> // for memcmp
+#include <vector>
+#include <limits>
+#include <atomic>
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+#include "event_filter.hpp"
+#include "decode_limits.hpp"
+
+namespace decoding
+{
+    typedef const unsigned char *byte_iterator;
+
+    /// number of data bytes that follow a channel event status byte, indexed by the high nibble of that status byte.
+    /// A length of zero means that the status byte does not start a channel event.
+    constexpr unsigned char channel_event_length[16] = {
+        0, 0, 0, 0, 0, 0, 0, 0, // no status byte
+        2, // 0x80 note off
+        2, // 0x90 note on
+        2, // 0xa0 note aftertouch
+        2, // 0xb0 controller
+        1, // 0xc0 program change
+        1, // 0xd0 channel aftertouch
+        2, // 0xe0 pitch bend
+        0  // 0xf0 sysex and meta events
+    };
+
+    /// read a variable length quantity: zero or more bytes with the high bit set, followed by a single byte with a zero
+    /// most significant bit. Returns false if the input ends before the quantity does or if the quantity takes more
+    /// than max_bytes bytes.
+    inline bool read_variable_length_quantity( byte_iterator &first, byte_iterator last, size_t &value, size_t max_bytes = std::numeric_limits<size_t>::max())
+    {
+        size_t result = 0;
+        for (byte_iterator current = first; current != last; ++current)
+        {
+            result = (result << 7) + (*current & 0x7f);
+            if (!(*current & 0x80))
+            {
+                if (size_t( current - first) >= max_bytes) return false;
+                first = current + 1;
+                value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// read a big endian 32-bit word.
+    inline bool read_big_dword( byte_iterator &first, byte_iterator last, unsigned &value)
+    {
+        if (last - first < 4) return false;
+        value = (unsigned( first[0]) << 24) | (unsigned( first[1]) << 16) | (unsigned( first[2]) << 8) | first[3];
+        first += 4;
+        return true;
+    }
+
+    /// read a big endian 16-bit word.
+    inline bool read_big_word( byte_iterator &first, byte_iterator last, unsigned &value)
+    {
+        if (last - first < 2) return false;
+        value = (unsigned( first[0]) << 8) | first[1];
+        first += 2;
+        return true;
+    }
+
+    /// read a chunk signature (like "MTrk") followed by a chunk size.
+    /// Returns false if the signature doesn't match or if the input ends prematurely.
+    inline bool read_chunk_header( byte_iterator &first, byte_iterator last, const char *signature, unsigned &size)
+    {
+        byte_iterator current = first;
+        if (last - current < 4 || std::memcmp( current, signature, 4) != 0) return false;
+        current += 4;
+        if (!read_big_dword( current, last, size)) return false;
+        first = current;
+        return true;
+    }
+
+    /// read the header chunk of a midi file.
+    inline bool read_header( byte_iterator &first, byte_iterator last, midi_header &header)
+    {
+        byte_iterator current = first;
+        unsigned size = 0;
+        if (   !read_chunk_header( current, last, "MThd", size)
+            || size != 6
+            || !read_big_word( current, last, header.format)
+            || !read_big_word( current, last, header.number_of_tracks)
+            || !read_big_word( current, last, header.division))
+        {
+            return false;
+        }
+        first = current;
+        return true;
+    }
+
+    /// decode a single event (without its delta time) at 'first' and advance 'first' to the end of the event.
+    /// The corresponding member function of handler is called for the event:
+    ///  * handler.channel_event( delta_time, status, data1, data2) for note, controller, program, aftertouch and pitch bend events,
+    ///  * handler.meta_event( delta_time, type, data, size) for meta events,
+    ///  * handler.sysex_event( delta_time, status, data, size) for sysex events.
+    /// data pointers point into the decoded input. The delta_time argument is passed on to the handler unchanged.
+    /// running_status holds the most recent channel event status byte and will be updated while decoding.
+    /// A negative value means that there is no running status (yet).
+    /// Returns false if the input at first is not a valid midi event or if the event exceeds the limits. Payload lengths
+    /// are always checked against the remaining input before the handler is called.
+    template<typename Handler>
+    bool decode_event( byte_iterator &first, byte_iterator last, unsigned delta_time, int &running_status, Handler &handler, const decode_limits &limits = decode_limits())
+    {
+        if (first == last) return false;
+
+        const unsigned char status = *first;
+        if (status == 0xff)
+        {
+            // meta event: type, length, data
+            byte_iterator current = first + 1;
+            if (current == last) return false;
+            const unsigned char type = *current++;
+            size_t size = 0;
+            if (   !read_variable_length_quantity( current, last, size, limits.max_quantity_bytes)
+                || size_t( last - current) < size
+                || size > limits.max_payload_size)
+            {
+                return false;
+            }
+            handler.meta_event( delta_time, type, current, size);
+            first = current + size;
+        }
+        else if (status == 0xf0 || status == 0xf7)
+        {
+            // sysex event: length, data
+            byte_iterator current = first + 1;
+            size_t size = 0;
+            if (   !read_variable_length_quantity( current, last, size, limits.max_quantity_bytes)
+                || size_t( last - current) < size
+                || size > limits.max_payload_size)
+            {
+                return false;
+            }
+            handler.sysex_event( delta_time, status, current, size);
+            first = current + size;
+        }
+        else
+        {
+            // channel event, possibly using running status.
+            byte_iterator current = first;
+            if (status & 0x80)
+            {
+                running_status = status;
+                ++current;
+            }
+
+            if (running_status < 0) return false;
+            const unsigned length = channel_event_length[ running_status >> 4];
+            if (length == 0 || unsigned( last - current) < length) return false;
+
+            handler.channel_event(
+                    delta_time,
+                    static_cast<unsigned char>( running_status),
+                    current[0],
+                    length == 2 ? current[1] : 0);
+            first = current + length;
+        }
+
+        return true;
+    }
+
+    /// decode all events in the track data [first, last).
+    /// For every event, decode_event() calls the corresponding member function of handler.
+    /// Returns true iff the complete range consists of one or more midi events within the given limits.
+    template<typename Handler>
+    bool decode_track_events( byte_iterator first, byte_iterator last, int &running_status, Handler &handler, const decode_limits &limits = decode_limits())
+    {
+        if (first == last) return false;
+
+        while (first != last)
+        {
+            size_t delta_time = 0;
+            if (   !read_variable_length_quantity( first, last, delta_time, limits.max_quantity_bytes)
+                || !decode_event( first, last, static_cast<unsigned>( delta_time), running_status, handler, limits))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /// The location of the data of a track chunk in the input.
+    struct track_chunk
+    {
+        byte_iterator begin;
+        byte_iterator end;
+    };
+
+    /// find the boundaries of all track chunks in [first, last), where first points just after the header chunk.
+    /// This only reads chunk headers, the events inside the chunks are not looked at.
+    /// Returns false if the input does not consist of complete track chunks.
+    inline bool find_track_chunks( byte_iterator first, byte_iterator last, std::vector<track_chunk> &chunks)
+    {
+        chunks.clear();
+        while (first != last)
+        {
+            unsigned chunk_size = 0;
+            if (!read_chunk_header( first, last, "MTrk", chunk_size) || size_t( last - first) < chunk_size) return false;
+            track_chunk chunk;
+            chunk.begin = first;
+            chunk.end = first + chunk_size;
+            chunks.push_back( chunk);
+            first += chunk_size;
+        }
+        return true;
+    }
+
+    /// Convert a channel event as found in a midi file into a events::channel_event.
+    /// status must be a status byte for which channel_event_length is non-zero.
+    inline void make_channel_event( unsigned char status, unsigned char data1, unsigned char data2, events::channel_event &result)
+    {
+        using namespace events;
+        result.channel = status & 0x0f;
+        switch (status & 0xf0)
+        {
+        case 0x80:
+            {
+                note_off n;
+                n.number = data1;
+                n.velocity = data2;
+                result.event = n;
+            }
+            break;
+        case 0x90:
+            {
+                note_on n;
+                n.number = data1;
+                n.velocity = data2;
+                result.event = n;
+            }
+            break;
+        case 0xa0:
+            {
+                note_aftertouch n;
+                n.number = data1;
+                n.velocity = data2;
+                result.event = n;
+            }
+            break;
+        case 0xb0:
+            {
+                controller c;
+                c.which = data1;
+                c.value = data2;
+                result.event = c;
+            }
+            break;
+        case 0xc0:
+            result.event = program_change( data1);
+            break;
+        case 0xd0:
+            result.event = channel_aftertouch( data1);
+            break;
+        case 0xe0:
+            // note how the pitch bend value is little endian
+            result.event = pitch_bend( static_cast<unsigned short>( data1 | (data2 << 8)));
+            break;
+        }
+    }
+
+    /// The inverse of make_channel_event: determine the status byte and data bytes of a channel event as they would
+    /// appear in a midi file. For events with only one data byte, data2 is set to zero.
+    inline void split_channel_event( const events::channel_event &event, unsigned char &status, unsigned char &data1, unsigned char &data2)
+    {
+        struct splitter : boost::static_visitor<>
+        {
+            splitter( unsigned char &status, unsigned char &data1, unsigned char &data2)
+                : status( status), data1( data1), data2( data2)
+            {
+            }
+
+            void operator()( const events::note_off &e) const         { set( 0x80, e.number, e.velocity); }
+            void operator()( const events::note_on &e) const          { set( 0x90, e.number, e.velocity); }
+            void operator()( const events::note_aftertouch &e) const  { set( 0xa0, e.number, e.velocity); }
+            void operator()( const events::controller &e) const       { set( 0xb0, e.which, e.value); }
+            void operator()( const events::program_change &e) const   { set( 0xc0, e.program, 0); }
+            void operator()( const events::channel_aftertouch &e) const { set( 0xd0, e.value, 0); }
+            void operator()( const events::pitch_bend &e) const       { set( 0xe0, e.value & 0xff, e.value >> 8); }
+
+            void set( unsigned char s, unsigned char d1, unsigned char d2) const
+            {
+                status = s;
+                data1 = d1;
+                data2 = d2;
+            }
+
+            unsigned char &status;
+            unsigned char &data1;
+            unsigned char &data2;
+        };
+
+        boost::apply_visitor( splitter( status, data1, data2), event.event);
+        status |= event.channel & 0x0f;
+    }
+
+    /// estimate the number of events in a track chunk of the given size, so that tracks can be reserved up front.
+    /// Most events in real files take three or four bytes: a one-byte delta time and two data bytes, with or without a
+    /// status byte.
+    inline size_t estimate_event_count( size_t chunk_size)
+    {
+        return chunk_size / 3;
+    }
+
+    /// Decoder handler that appends all events to a midi_track.
+    /// If sysex_data is non-null, the payloads of sysex events are appended to it, otherwise they are dropped.
+    struct track_builder
+    {
+        explicit track_builder( midi_track &track, midi_file::sysex_data_type *sysex_data = 0)
+            : track( track), sysex_data( sysex_data)
+        {
+        }
+
+        void channel_event( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+        {
+            events::channel_event event;
+            make_channel_event( status, data1, data2, event);
+            append( delta_time).event = event;
+        }
+
+        void meta_event( unsigned delta_time, unsigned char type, byte_iterator data, size_t size)
+        {
+            // the data bytes are allocated from the same memory resource as the track and moved, not copied, into
+            // the track.
+            events::meta event( track.get_allocator());
+            event.type = type;
+            event.bytes.assign( data, data + size);
+
+            events::timed_midi_event appended = { delta_time, std::move( event)};
+            track.push_back( std::move( appended));
+        }
+
+        void sysex_event( unsigned delta_time, unsigned char status, byte_iterator data, size_t size)
+        {
+            events::sysex event;
+            event.status = status;
+            if (sysex_data)
+            {
+                event.offset = static_cast<unsigned>( sysex_data->size());
+                event.size = static_cast<unsigned>( size);
+                sysex_data->insert( sysex_data->end(), data, data + size);
+            }
+            append( delta_time).event = event;
+        }
+
+    private:
+        events::timed_midi_event &append( unsigned delta_time)
+        {
+            track.push_back( events::timed_midi_event());
+            track.back().delta_time = delta_time;
+            return track.back();
+        }
+
+        midi_track                  &track;
+        midi_file::sysex_data_type  *sysex_data;
+    };
+
+    /// Decoder handler that builds nothing, but determines how many events a track holds and how much memory a
+    /// track_builder would need for them. This is used to check a track against decode_limits before allocating.
+    struct track_measurer
+    {
+        explicit track_measurer( bool capture_sysex)
+            : capture_sysex( capture_sysex), events( 0), payload_bytes( 0)
+        {
+        }
+
+        void channel_event( unsigned, unsigned char, unsigned char, unsigned char)
+        {
+            ++events;
+        }
+
+        void meta_event( unsigned, unsigned char, byte_iterator, size_t size)
+        {
+            ++events;
+            payload_bytes += size;
+        }
+
+        void sysex_event( unsigned, unsigned char, byte_iterator, size_t size)
+        {
+            ++events;
+            if (capture_sysex) payload_bytes += size;
+        }
+
+        /// the number of bytes that the track object, its events and their payloads take, not counting allocator overhead.
+        size_t memory() const
+        {
+            return sizeof( midi_track) + events * sizeof( events::timed_midi_event) + payload_bytes;
+        }
+
+        bool    capture_sysex;
+        size_t  events;
+        size_t  payload_bytes;
+    };
+
+    /// Decoder handler that only appends the events that pass an event_filter to a midi_track.
+    /// Rejected events are decoded far enough to find their end, but no event objects are built for them. Their delta
+    /// times are added to the delta time of the next accepted event, so accepted events keep their absolute time.
+    /// If that sum doesn't fit in the delta time of an event, the event is not appended and overflowed() becomes true.
+    /// The delta times of rejected events after the last accepted event are not carried by any event, so a filtered
+    /// track ends at its last accepted event. A filter that rejects the end-of-track meta event (type 0x2f) therefore
+    /// shortens the track, unless it is accepted explicitly, e.g. by adding meta_events to the types of the filter and
+    /// setting only 0x2f in its meta_types. trailing_time() returns the time that was dropped.
+    struct filtering_track_builder
+    {
+        filtering_track_builder( midi_track &track, midi_file::sysex_data_type *sysex_data, const event_filter &filter)
+            : builder( track, sysex_data), filter( filter), skipped_time( 0), overflow( false)
+        {
+        }
+
+        void channel_event( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+        {
+            if (!filter.accepts_channel_event( status))
+            {
+                skipped_time += delta_time;
+            }
+            else if (accepted_time( delta_time))
+            {
+                builder.channel_event( delta_time, status, data1, data2);
+            }
+        }
+
+        void meta_event( unsigned delta_time, unsigned char type, byte_iterator data, size_t size)
+        {
+            if (!filter.accepts_meta_event( type))
+            {
+                skipped_time += delta_time;
+            }
+            else if (accepted_time( delta_time))
+            {
+                builder.meta_event( delta_time, type, data, size);
+            }
+        }
+
+        void sysex_event( unsigned delta_time, unsigned char status, byte_iterator data, size_t size)
+        {
+            if (!filter.accepts_sysex_event())
+            {
+                skipped_time += delta_time;
+            }
+            else if (accepted_time( delta_time))
+            {
+                builder.sysex_event( delta_time, status, data, size);
+            }
+        }
+
+        /// true if the delta time of an accepted event, including the time of the rejected events before it, was too
+        /// large to be stored. The track is incomplete in that case.
+        bool overflowed() const
+        {
+            return overflow;
+        }
+
+        /// the sum of the delta times of the rejected events after the last accepted event.
+        boost::uint64_t trailing_time() const
+        {
+            return skipped_time;
+        }
+
+    private:
+        /// add the skipped time to the delta time of an accepted event. Returns false if the result doesn't fit.
+        bool accepted_time( unsigned &delta_time)
+        {
+            const boost::uint64_t time = skipped_time + delta_time;
+            skipped_time = 0;
+            if (time > std::numeric_limits<unsigned>::max())
+            {
+                overflow = true;
+                return false;
+            }
+            delta_time = static_cast<unsigned>( time);
+            return true;
+        }
+
+        track_builder       builder;
+        const event_filter  &filter;
+        boost::uint64_t     skipped_time; ///< sum of the delta times of the events since the last accepted event.
+        bool                overflow;
+    };
+
+    /// Decode the events of one track chunk into 'track'. Sysex payloads are appended to sysex_data, unless it is null.
+    /// The track only holds the events that pass 'filter'. With limits, the track is measured first and the memory
+    /// that it will take is added to memory_used, which is shared by all tracks of a file. Nothing is allocated for a
+    /// track that exceeds the limits, and such a track is not added to memory_used.
+    /// Returns false if the chunk is not a well-formed track, exceeds the limits or, when filtering, if a kept event
+    /// would get a delta time that doesn't fit, see filtering_track_builder. In that case, the track and sysex_data may
+    /// hold a part of the events.
+    bool decode_track_chunk(
+        const track_chunk &chunk, int &running_status, midi_track &track, midi_file::sysex_data_type *sysex_data,
+        const event_filter &filter, const decode_limits &limits, std::atomic<size_t> &memory_used);
+
+    /// Decode the midi file at [data, data + size) into 'result'.
+    /// If capture_sysex is true, sysex payloads are stored in result.sysex_data.
+    /// The tracks in result only hold the events that pass 'filter', see filtering_track_builder.
+    /// If limits are given, every track is measured with a track_measurer before it is built, and the file is rejected
+    /// as soon as a track exceeds the limits.
+    /// Returns true iff the complete input could be decoded as a midi file. If false is returned, the contents of
+    /// result are unspecified.
+    bool decode_midifile( const unsigned char *data, size_t size, midi_file &result, bool capture_sysex = false, const event_filter &filter = event_filter(), const decode_limits &limits = decode_limits());
+
+    /// Decode the midi file at [data, data + size) into 'result', decoding the tracks concurrently.
+    /// First the track chunk boundaries are determined, then the tracks are divided over 'threads' threads (zero
+    /// means: one per hardware thread). Every track starts without running status, as the midi file specification
+    /// requires, so unlike decode_midifile(), this doesn't accept files that continue a running status from one track
+    /// into the next. The memory limit applies to all threads together.
+    /// Returns true iff the complete input could be decoded as a midi file. If false is returned, the contents of
+    /// result are unspecified.
+    bool decode_midifile_parallel( const unsigned char *data, size_t size, midi_file &result, unsigned threads, bool capture_sysex = false, const event_filter &filter = event_filter(), const decode_limits &limits = decode_limits());
+}
+
+#endif //MIDI_DECODER_HPP
@@ -0,0 +1,229 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a streaming alternative to parse_midifile() followed by a midi_multiplexer.
+/// Instead of building a midi_file, the events are decoded one at a time and offered to a visitor directly.
+/// Memory use does not depend on the number of events in the file; per track only a read position and the
+/// running status are kept.
+
+#if !defined( MIDI_EVENT_STREAM_HPP)
+#define MIDI_EVENT_STREAM_HPP
+#include <vector>
+#include <type_traits> // for remove_reference
+#include <algorithm> // for push_heap, pop_heap, make_heap
+#include <boost/cstdint.hpp>
+#include <boost/ref.hpp>
+#include "midi_decoder.hpp"
+
+namespace decoding
+{
+    /// Reads the events of one track chunk lazily, one event at a time.
+    /// After construction and after every call to next(), the delta time of the upcoming event has been read.
+    class track_reader
+    {
+    public:
+        track_reader( const track_chunk &chunk, size_t index)
+            : index( index), time( 0), delta_time( 0), valid( true), current( chunk.begin), end( chunk.end), running_status( -1)
+        {
+            read_delta_time();
+        }
+
+        /// true if there are no more events in this track.
+        bool empty() const
+        {
+            return current == end || !valid;
+        }
+
+        /// decode the upcoming event, offer it to handler and read the delta time of the next event.
+        /// Returns false if the event could not be decoded.
+        template<typename Handler>
+        bool next( Handler &handler)
+        {
+            if (!decode_event( current, end, delta_time, running_status, handler))
+            {
+                valid = false;
+                return false;
+            }
+            return read_delta_time();
+        }
+
+        size_t                  index;      ///< index of the track in the file.
+        boost::uint64_t         time;       ///< absolute time of the upcoming event.
+        unsigned                delta_time; ///< delta time of the upcoming event.
+        bool                    valid;      ///< false if a decoding error was encountered.
+
+    private:
+        bool read_delta_time()
+        {
+            if (current == end) return true;
+            size_t delta = 0;
+            if (!read_variable_length_quantity( current, end, delta) || current == end)
+            {
+                valid = false;
+                return false;
+            }
+            delta_time = static_cast<unsigned>( delta);
+            time += delta_time;
+            return true;
+        }
+
+        byte_iterator   current;
+        byte_iterator   end;
+        int             running_status;
+    };
+
+    /// Decoder handler that converts decoded events into timed_midi_events and offers them to a visitor as
+    /// timed_midi_event_refs.
+    /// Events are created in reusable slots, so that decoding meta events does not allocate once the slot's buffer is
+    /// large enough.
+    template<typename Visitor>
+    class visiting_handler
+    {
+    public:
+        /// sysex events that are offered refer to their payload by an offset relative to 'input'.
+        visiting_handler( Visitor &visitor, byte_iterator input)
+            : visitor( visitor), input( input), absolute_time( 0), offered_delta( 0)
+        {
+            meta_slot.event = events::meta();
+            sysex_slot.event = events::sysex();
+            channel_slot.event = events::channel_event();
+        }
+
+        /// set the time stamps for the next event that will be offered.
+        void set_time( boost::uint64_t absolute, unsigned delta)
+        {
+            absolute_time = absolute;
+            offered_delta = delta;
+        }
+
+        void channel_event( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+        {
+            channel_slot.delta_time = delta_time;
+            make_channel_event( status, data1, data2, boost::get<events::channel_event>( channel_slot.event));
+            offer( channel_slot);
+        }
+
+        void meta_event( unsigned delta_time, unsigned char type, byte_iterator data, size_t size)
+        {
+            meta_slot.delta_time = delta_time;
+            events::meta &meta = boost::get<events::meta>( meta_slot.event);
+            meta.type = type;
+            meta.bytes.assign( data, data + size);
+            offer( meta_slot);
+        }
+
+        void sysex_event( unsigned delta_time, unsigned char status, byte_iterator data, size_t size)
+        {
+            sysex_slot.delta_time = delta_time;
+            events::sysex &sysex = boost::get<events::sysex>( sysex_slot.event);
+            sysex.status = status;
+            sysex.offset = static_cast<unsigned>( data - input);
+            sysex.size = static_cast<unsigned>( size);
+            offer( sysex_slot);
+        }
+
+    private:
+        void offer( const events::timed_midi_event &event)
+        {
+            visitor( events::timed_midi_event_ref( absolute_time, offered_delta, event));
+        }
+
+        Visitor                     &visitor;
+        byte_iterator               input;
+        boost::uint64_t             absolute_time;
+        unsigned                    offered_delta;
+        events::timed_midi_event    meta_slot;
+        events::timed_midi_event    sysex_slot;
+        events::timed_midi_event    channel_slot;
+    };
+
+    /// heap ordering for track readers, equal to the ordering that midi_multiplexer uses.
+    struct later_reader
+    {
+        bool operator()( const track_reader &lhs, const track_reader &rhs) const
+        {
+            return lhs.time > rhs.time || (lhs.time == rhs.time && lhs.index > rhs.index);
+        }
+    };
+}
+
+/// Read only the header chunk of the midi file at [data, data + size).
+inline bool parse_midi_header( const unsigned char *data, size_t size, midi_header &header)
+{
+    decoding::byte_iterator first = data;
+    return decoding::read_header( first, data + size, header);
+}
+
+/// Decode the midi file at [data, data + size) and offer its events to 'visitor' while decoding, without building a
+/// midi_file.
+/// The visitor receives events::timed_midi_event_refs in the same order and with the same time stamps that a
+/// midi_multiplexer would offer them after a full parse, so any visitor derived from events::visitor can be used.
+/// The referenced events are only valid during the call to the visitor. Sysex events refer to their payload by an
+/// offset relative to 'data'.
+/// For a format 0 file this is a single pass over the data. For files with several tracks, the tracks are decoded
+/// lazily and interleaved on the fly: only a read position and a running status are kept per track. Unlike
+/// parse_midifile(), every track starts without running status.
+/// Because events are offered while decoding, the visitor may have seen events before a decoding error is found. The
+/// return value is true iff the complete file could be decoded.
+template<typename Visitor>
+bool stream_midifile( const unsigned char *data, size_t size, Visitor &&visitor)
+{
+    using namespace decoding;
+
+    typedef typename boost::unwrap_reference<typename std::remove_reference<Visitor>::type>::type visitor_type;
+    visiting_handler<visitor_type> handler( boost::unwrap_ref( visitor), data);
+
+    byte_iterator first = data;
+    byte_iterator last = data + size;
+    if (first == last) return true;
+
+    midi_header header;
+    std::vector<track_chunk> chunks;
+    if (!read_header( first, last, header) || !find_track_chunks( first, last, chunks)) return false;
+
+    std::vector<track_reader> readers;
+    readers.reserve( chunks.size());
+    for (size_t index = 0; index != chunks.size(); ++index)
+    {
+        readers.push_back( track_reader( chunks[index], index));
+
+        // empty tracks are not valid midi tracks
+        if (readers.back().empty()) return false;
+    }
+    std::make_heap( readers.begin(), readers.end(), later_reader());
+
+    boost::uint64_t current_time = 0;
+    while (!readers.empty())
+    {
+        std::pop_heap( readers.begin(), readers.end(), later_reader());
+        track_reader &earliest = readers.back();
+
+        // offer the earliest event, and all simultaneous events of the same track.
+        handler.set_time( earliest.time, static_cast<unsigned>( earliest.time - current_time));
+        current_time = earliest.time;
+        if (!earliest.next( handler)) return false;
+        while (!earliest.empty() && earliest.delta_time == 0)
+        {
+            handler.set_time( current_time, 0);
+            if (!earliest.next( handler)) return false;
+        }
+
+        if (earliest.empty())
+        {
+            readers.pop_back();
+        }
+        else
+        {
+            std::push_heap( readers.begin(), readers.end(), later_reader());
+        }
+    }
+
+    return true;
+}
+
+#endif //MIDI_EVENT_STREAM_HPP
@@ -9,7 +9,10 @@
 #ifndef MIDI_EVENT_TYPES_HPP
 #define MIDI_EVENT_TYPES_HPP
 
+#include <vector>
+#include <memory_resource>
 #include <boost/variant.hpp>
+#include <boost/cstdint.hpp>
 
 /// This namespace contains a struct definition for each type of midi event that can be found in a midi file.
 /// The midi file parser will create objects of these types while parsing midi events and add them to a vector for each track in the midi file.
@@ -79,15 +82,58 @@ namespace events
         channel_event_variant event;
     };
 
+    /// A meta event: a type and some data bytes.
+    /// The data bytes are allocator-aware, so that they can be allocated from the same memory resource as the track
+    /// that holds the event.
     struct meta
     {
-        unsigned char       type;
-        std::vector<unsigned char>   bytes;
+        typedef std::pmr::vector<unsigned char> bytes_type;
+        typedef bytes_type::allocator_type      allocator_type;
+
+        meta()
+            : type( 0)
+        {
+        }
+
+        explicit meta( const allocator_type &allocator)
+            : type( 0), bytes( allocator)
+        {
+        }
+
+        meta( const meta &other) = default;
+        meta( meta &&other) = default;
+        meta &operator=( const meta &other) = default;
+        meta &operator=( meta &&other) = default;
+
+        meta( const meta &other, const allocator_type &allocator)
+            : type( other.type), bytes( other.bytes, allocator)
+        {
+        }
+
+        meta( meta &&other, const allocator_type &allocator)
+            : type( other.type), bytes( std::move( other.bytes), allocator)
+        {
+        }
+
+        unsigned char   type;
+        bytes_type      bytes;
     };
 
-    /// we're not doing anything with sysex messages right now.
+    /// A system exclusive message.
+    /// To avoid an allocation per message, the payload is not stored in the event itself. Instead, offset and size
+    /// refer to a byte range in the sysex_data of the midi_file that contains the event (or, for events offered by
+    /// stream_midifile(), to a range in the input buffer).
+    /// Payloads are only stored if that was requested while parsing, otherwise size is zero.
     struct sysex
     {
+        sysex()
+            : status( 0xf0), offset( 0), size( 0)
+        {
+        }
+
+        unsigned char   status; ///< 0xf0 for a complete message, 0xf7 for an escape or continuation packet.
+        unsigned        offset;
+        unsigned        size;
     };
 
     /// This type can hold any midi event encountered in a midi file.
@@ -103,6 +149,77 @@ namespace events
         unsigned delta_time;
         midi_event event;
     };
+
+    /// A lightweight view of a timed_midi_event with a different time stamp.
+    /// This is used to offer events to visitors in another context (e.g. in a multiplexed stream of several tracks)
+    /// without copying them.
+    struct timed_midi_event_ref
+    {
+        timed_midi_event_ref( boost::uint64_t absolute_time, unsigned delta_time, const timed_midi_event &event)
+            : absolute_time( absolute_time), delta_time( delta_time), event( event)
+        {
+        }
+
+        /// Create a copy of the referenced event, with the delta time of this view.
+        /// This allows visitors that only know about timed_midi_events to be used where timed_midi_event_refs are offered.
+        operator timed_midi_event() const
+        {
+            timed_midi_event result( event);
+            result.delta_time = delta_time;
+            return result;
+        }
+
+        boost::uint64_t         absolute_time;  ///< time since the start of the file
+        unsigned                delta_time;     ///< time since the previous event, replaces event.delta_time.
+        const timed_midi_event &event;
+    };
+
+    // Equality operators, so that complete tracks and files can be compared, e.g. to check that two parsers
+    // produce the same results.
+    inline bool operator==( const note &lhs, const note &rhs)
+    {
+        return lhs.number == rhs.number && lhs.velocity == rhs.velocity;
+    }
+
+    inline bool operator==( const controller &lhs, const controller &rhs)
+    {
+        return lhs.which == rhs.which && lhs.value == rhs.value;
+    }
+
+    inline bool operator==( const program_change &lhs, const program_change &rhs)
+    {
+        return lhs.program == rhs.program;
+    }
+
+    inline bool operator==( const channel_aftertouch &lhs, const channel_aftertouch &rhs)
+    {
+        return lhs.value == rhs.value;
+    }
+
+    inline bool operator==( const pitch_bend &lhs, const pitch_bend &rhs)
+    {
+        return lhs.value == rhs.value;
+    }
+
+    inline bool operator==( const channel_event &lhs, const channel_event &rhs)
+    {
+        return lhs.channel == rhs.channel && lhs.event == rhs.event;
+    }
+
+    inline bool operator==( const meta &lhs, const meta &rhs)
+    {
+        return lhs.type == rhs.type && lhs.bytes == rhs.bytes;
+    }
+
+    inline bool operator==( const sysex &lhs, const sysex &rhs)
+    {
+        return lhs.status == rhs.status && lhs.offset == rhs.offset && lhs.size == rhs.size;
+    }
+
+    inline bool operator==( const timed_midi_event &lhs, const timed_midi_event &rhs)
+    {
+        return lhs.delta_time == rhs.delta_time && lhs.event == rhs.event;
+    }
 } // namespace events
 
 #endif // MIDI_EVENT_TYPES_HPP
@@ -41,6 +41,13 @@ namespace events
             derived()( event.event);
         }
 
+        /// ignore the time stamp of the view and descent into the referenced event.
+        /// Note that derived classes that override the timed_midi_event overload should normally override this one too.
+        void operator()( const timed_midi_event_ref &event)
+        {
+            derived()( event.event.event);
+        }
+
         /// figure out the actual type of the event and visit that one.
         void operator()( const midi_event &event)
         {
@@ -86,6 +93,12 @@ namespace events
             derived()( event.event);
         }
 
+        void operator()( const timed_midi_event_ref &event)
+        {
+            current_time += event.delta_time;
+            derived()( event.event.event);
+        }
+
         void reset()
         {
             current_time = 0;
@@ -12,10 +12,12 @@
 #define MIDI_FILE_HPP
 
 #include <vector>
+#include <memory_resource>
 #include "midi_event_types.hpp"
 
 /// typedef for a chronologically ordered container of timed midi events.
-typedef std::vector< events::timed_midi_event>   midi_track;
+/// Tracks are allocator-aware, a track that is part of a midi_file uses the memory resource of that file.
+typedef std::pmr::vector< events::timed_midi_event>   midi_track;
 
 /// Information of a midi file header chunk.
 struct midi_header
@@ -26,11 +28,55 @@ struct midi_header
 };
 
 /// In-memory representation of the information found in a midi file.
+/// A midi_file can be constructed with a memory resource. Its tracks, the events in the tracks and the meta event data
+/// will then be allocated from that resource when the file is filled by the table decoder. This allows a complete
+/// file to be parsed into, for instance, a std::pmr::monotonic_buffer_resource and to be released in one go. The
+/// resource must outlive the midi_file. Copies of a midi_file use the default memory resource.
 struct midi_file
 {
-    typedef std::vector<midi_track> tracks_type;
+    typedef std::pmr::vector<midi_track> tracks_type;
+    typedef std::pmr::vector<unsigned char> sysex_data_type;
+
+    midi_file()
+    {
+    }
+
+    explicit midi_file( std::pmr::memory_resource *resource)
+        : tracks( resource), sysex_data( resource)
+    {
+    }
+
+    /// the memory resource that is used for the tracks of this file.
+    std::pmr::memory_resource *resource() const
+    {
+        return tracks.get_allocator().resource();
+    }
+
     midi_header header;
     tracks_type tracks;
+
+    /// The payloads of all sysex events in the tracks, if they were captured.
+    /// Sysex events refer to their payload by offset and size in this arena.
+    sysex_data_type sysex_data;
+
+    /// return a pointer to the first byte of the payload of a sysex event in this file.
+    /// The payload consists of event.size bytes.
+    const unsigned char *sysex_bytes( const events::sysex &event) const
+    {
+        return sysex_data.empty() ? 0 : &sysex_data[0] + event.offset;
+    }
 };
 
+inline bool operator==( const midi_header &lhs, const midi_header &rhs)
+{
+    return lhs.format == rhs.format
+        && lhs.number_of_tracks == rhs.number_of_tracks
+        && lhs.division == rhs.division;
+}
+
+inline bool operator==( const midi_file &lhs, const midi_file &rhs)
+{
+    return lhs.header == rhs.header && lhs.tracks == rhs.tracks && lhs.sysex_data == rhs.sysex_data;
+}
+
 #endif //MIDI_FILE_HPP
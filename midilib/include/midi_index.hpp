@@ -0,0 +1,132 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains an index on a parsed midi file that allows random access by absolute time.
+
+#if !defined( MIDI_INDEX_HPP)
+#define MIDI_INDEX_HPP
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+#include "midi_multiplexer.hpp"
+#include "tempo_map.hpp"
+
+/// The state of a midi channel as set by controller, program change and pitch bend events.
+/// Values that were never set by any event have the value not_set.
+struct channel_state
+{
+    static const unsigned char  not_set = 0xff;
+    static const unsigned short pitch_bend_not_set = 0xffff;
+
+    channel_state();
+
+    unsigned char   program;
+    unsigned short  pitch_bend;
+    unsigned char   controllers[128];
+};
+
+/// The state of playback at a given point in time: the tempo and the state of all channels.
+/// A player that starts in the middle of a file can send this state before it starts playing events.
+struct playback_state
+{
+    playback_state();
+
+    /// update the state with a single event. Events that do not change the state are ignored.
+    void apply( const events::midi_event &event);
+
+    boost::uint64_t tick;
+    unsigned        tempo; ///< microseconds per quarter note, tempo_map::default_tempo if no tempo was set.
+    channel_state   channels[16];
+};
+
+/// An index on a midi_file that is built once and then allows seeking to any point in the file without replaying all
+/// events from the start.
+/// The index holds the absolute time of every event in every track, a snapshot of the playback state at every
+/// multiple of a fixed snapshot interval and the tempo map of the file, so that seeking to a time in seconds is
+/// possible too.
+/// Finding the events in each track at a given time takes O(log n) time. The playback state at a given time is
+/// computed from the nearest earlier snapshot by replaying at most one snapshot interval of events.
+/// The index refers to the midi_file it was built from, which must outlive the index and must not be modified.
+class midi_index
+{
+public:
+    typedef boost::uint64_t                         tick_type;
+    typedef std::vector<tick_type>                  tick_table;
+    typedef midi_multiplexer::positions_type        positions_type;
+
+    /// build an index for the given file. If snapshot_interval is zero, a snapshot is made every 16 quarter notes or,
+    /// for SMPTE time division, every 4 seconds.
+    explicit midi_index( const midi_file &file, tick_type snapshot_interval = 0);
+
+    const midi_file &file() const
+    {
+        return *indexed_file;
+    }
+
+    /// absolute time in ticks of the last event in the file.
+    tick_type length() const
+    {
+        return last_tick;
+    }
+
+    /// absolute times of all events in a track.
+    const tick_table &ticks( size_t track) const
+    {
+        return track_ticks[track];
+    }
+
+    /// index of the first event in a track at or after the given time. This is the size of the track if there is none.
+    size_t position( size_t track, tick_type tick) const;
+
+    /// get for each track the position of the first event at or after the given time.
+    void positions( tick_type tick, positions_type &result) const;
+
+    /// the playback state just before the given time, i.e. after all events before tick have been applied.
+    playback_state state_at( tick_type tick) const;
+
+    /// create a multiplexer that offers all events at or after the given time. The delta time of the first event
+    /// is relative to tick.
+    midi_multiplexer seek( tick_type tick) const;
+
+    /// create a multiplexer that offers all events at or after the given time in seconds.
+    midi_multiplexer seek_seconds( double seconds) const
+    {
+        return seek( file_tempo_map.seconds_to_ticks( seconds));
+    }
+
+    /// the tempo map of the file, to convert between ticks and seconds.
+    const tempo_map &tempos() const
+    {
+        return file_tempo_map;
+    }
+
+    /// the snapshots, one for every multiple of the snapshot interval up to the length of the file.
+    const std::vector<playback_state> &snapshots() const
+    {
+        return state_snapshots;
+    }
+
+    tick_type snapshot_interval() const
+    {
+        return interval;
+    }
+
+private:
+    struct index_builder;
+    friend struct index_builder;
+
+    const midi_file                 *indexed_file;
+    tick_type                       interval;
+    tick_type                       last_tick;
+    std::vector<tick_table>         track_ticks;
+    std::vector<playback_state>     state_snapshots;
+    tempo_map                       file_tempo_map;
+};
+
+#endif //MIDI_INDEX_HPP
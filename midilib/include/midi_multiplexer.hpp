@@ -9,92 +9,152 @@
 #if !defined( MIDI_MULTIPLEXER_HPP)
 #define MIDI_MULTIPLEXER_HPP
 #include <utility> // for std::pair
+#include <vector>
+#include <algorithm> // for push_heap, pop_heap, make_heap
+#include <iterator> // for std::next
+#include <boost/cstdint.hpp>
 #include <boost/function.hpp>
+#include <boost/ref.hpp>
 #include "midi_event_types.hpp"
 #include "midi_file.hpp" // for midi_track
 
+/// A position in a track from which multiplexing can resume: the index of the next event in the track and the
+/// absolute time of that event.
+struct multiplexer_position
+{
+    size_t          event;
+    boost::uint64_t time;
+};
+
 /// This class accepts a container of midi tracks and will offer the midi events in
 /// these tracks in chronological order to any visitor provided.
-class midi_multiplexer
+/// Internally, the tracks are kept in a min-heap, ordered on the absolute time of their next event, so that
+/// offering an event costs O(log(number of tracks)).
+/// Tracks can be any container with const_iterators that yield timed_midi_events, like midi_track or the tracks of a
+/// packed_midi_file or a midi_snapshot.
+template<typename Tracks>
+class basic_midi_multiplexer
 {
 
 public:
-    typedef midi_file::tracks_type     tracks_type;
-    midi_multiplexer( const tracks_type &tracks)
+    typedef Tracks                              tracks_type;
+    typedef boost::uint64_t                     time_type;
+    typedef multiplexer_position                track_position;
+    typedef std::vector<track_position>         positions_type;
+
+    basic_midi_multiplexer( const tracks_type &tracks)
+        : current_time( 0)
     {
-        for (tracks_type::const_iterator i = tracks.begin(); i != tracks.end();++i)
+        ranges.reserve( tracks.size());
+        for (typename tracks_type::const_iterator i = tracks.begin(); i != tracks.end();++i)
         {
             if (i->begin() != i->end())
             {
-                ranges.push_back( track_range( i->begin(), i->end()));
+                ranges.push_back( track_range( i->begin(), i->end(), i - tracks.begin()));
             }
         }
+        std::make_heap( ranges.begin(), ranges.end(), later());
     }
 
-    /// accept any visitor of timed_midi_events.
+    /// Create a multiplexer that resumes in the middle of the tracks.
+    /// positions must hold one track_position for each track. The first event that is offered will have a delta time
+    /// relative to start_time, which must not be later than any of the positions.
+    /// See midi_index for a way to obtain these positions for a given time.
+    basic_midi_multiplexer( const tracks_type &tracks, const positions_type &positions, time_type start_time)
+        : current_time( start_time)
+    {
+        ranges.reserve( tracks.size());
+        for (typename tracks_type::const_iterator i = tracks.begin(); i != tracks.end();++i)
+        {
+            const track_position &position = positions[ i - tracks.begin()];
+            if (position.event < i->size())
+            {
+                ranges.push_back( track_range( std::next( i->begin(), position.event), i->end(), i - tracks.begin(), position.time));
+            }
+        }
+        std::make_heap( ranges.begin(), ranges.end(), later());
+    }
+
+    /// accept any visitor of timed_midi_event_refs.
     /// This visitor will be provided with all events in all of the tracks in chronological order.
     /// All events in any given track that happen simultaneous (with zero time interval) will be offered consecutively.
+    /// Events of different tracks that happen at the same time are offered in track order.
+    /// Events are offered as views that carry the delta time relative to the previously offered event, so no
+    /// events are copied. The visitor is taken by reference (a boost::ref wrapper is unwrapped) and the call is resolved
+    /// statically, so visitors derived from events::visitor can be inlined completely.
+    template<typename Visitor>
+    void accept( Visitor &&visitor)
+    {
+        multiplex( boost::unwrap_ref( visitor));
+    }
+
+    /// accept any visitor of timed_midi_events.
+    /// This visitor is offered copies of the events with their delta time adapted.
     void accept( boost::function< void ( const events::timed_midi_event &)> v)
+    {
+        multiplex( v);
+    }
+
+private:
+    template<typename Visitor>
+    void multiplex( Visitor &v)
     {
         while (!ranges.empty())
         {
-            // find the range with the earliest event
-            ranges_vector::iterator 
-                earliest = find_earliest();
-
-            // invoke the visitor with the next event
-            events::timed_midi_event e = *earliest->begin;
-            e.delta_time = earliest->time();
-
-            v( e);
-            
-            // now adapt all other midi event delta times.
-            adapt_offsets( earliest->time());
+            // move the range with the earliest event to the back of the heap.
+            std::pop_heap( ranges.begin(), ranges.end(), later());
+            track_range &earliest = ranges.back();
 
-            ++earliest->begin;
-            earliest->offset = 0;
+            // invoke the visitor with the next event, its delta time is relative to the previously offered event.
+            const unsigned int delta_time = static_cast<unsigned int>( earliest.time - current_time);
+            current_time = earliest.time;
 
+            v( events::timed_midi_event_ref( current_time, delta_time, *earliest.begin));
+            ++earliest.begin;
 
             // while the range is not empty and there are events in this track that are simultaneous
             // give all these events to the visitor. This keeps simultaneous events in one track 
             // together.
             while (
-                    !earliest->empty()
-                &&    earliest->begin->delta_time == 0)
+                    !earliest.empty()
+                &&    earliest.begin->delta_time == 0)
             {
-                v( *earliest->begin);
-                ++earliest->begin;
+                v( events::timed_midi_event_ref( current_time, 0, *earliest.begin));
+                ++earliest.begin;
             }
 
-            // remove the track if we've exhausted all events.
-            if (earliest->empty())
+            // remove the track if we've exhausted all events, otherwise put it back in the heap.
+            if (earliest.empty())
             {
-                ranges.erase( earliest);
+                ranges.pop_back();
+            }
+            else
+            {
+                earliest.time += earliest.begin->delta_time;
+                std::push_heap( ranges.begin(), ranges.end(), later());
             }
         }
-        
-
     }
 
-private:
-    typedef midi_track::const_iterator track_iterator;
+    typedef typename tracks_type::value_type::const_iterator track_iterator;
+
     struct track_range
     {
-        unsigned int offset;
-        track_iterator begin;
-        track_iterator end;
+        time_type       time;   ///< absolute time of the first event in the range.
+        size_t          index;  ///< index of the track, used to order simultaneous events.
+        track_iterator  begin;
+        track_iterator  end;
 
-        track_range( track_iterator b, track_iterator e)
-            : offset(0), begin( b), end( e)
+        /// precondition: range is not empty.
+        track_range( track_iterator b, track_iterator e, size_t index)
+            : time( b->delta_time), index( index), begin( b), end( e)
         {
         }
 
-        /// returns the delta time of the first event
-        /// in the range, minus offset
-        /// precondition: range is not empty.
-        unsigned int time() const
+        /// precondition: range is not empty, time is the absolute time of the first event in the range.
+        track_range( track_iterator b, track_iterator e, size_t index, time_type time)
+            : time( time), index( index), begin( b), end( e)
         {
-            return begin->delta_time - offset;
         }
 
         bool empty() const
@@ -103,39 +163,23 @@ private:
         }
     };
 
-    typedef std::vector< track_range>  ranges_vector;
-
-    /// find the range with the earliest timed_midi_event.
-    /// precondition: ranges is not empty
-    ranges_vector::iterator find_earliest()
+    /// heap ordering: a range comes later than another if its next event is later, or if it is simultaneous and
+    /// the range belongs to a track with a higher index.
+    struct later
     {
-        ranges_vector::iterator i = ranges.begin();
-        ranges_vector::iterator earliest = i;
-        unsigned int earliest_time = i->time();
-
-        for ( /*nop*/; i != ranges.end(); ++i)
+        bool operator()( const track_range &lhs, const track_range &rhs) const
         {
-            if (i->time() < earliest_time)
-            {
-                earliest = i;
-                earliest_time = i->time();
-            }
+            return lhs.time > rhs.time || (lhs.time == rhs.time && lhs.index > rhs.index);
         }
+    };
 
-        return earliest;
-    }
-
-    /// subtract an offset from the first element of every range.
-    /// precondition: all ranges are non-empty and all offsets are at least 'offset'
-    void adapt_offsets( unsigned int offset)
-    {
-        for (ranges_vector::iterator i = ranges.begin(); i != ranges.end(); ++i)
-        {
-            i->offset += offset;
-        }
-    }
+    typedef std::vector< track_range>  ranges_vector;
 
     ranges_vector    ranges;
+    time_type        current_time; ///< absolute time of the last event that was offered.
 };
 
+/// The multiplexer for the tracks of a midi_file.
+typedef basic_midi_multiplexer<midi_file::tracks_type> midi_multiplexer;
+
 #endif //MIDI_MULTIPLEXER_HPP
@@ -9,10 +9,77 @@
 #if !defined( MIDI_PARSER_HPP)
 #define MIDI_PARSER_HPP
 #include <iosfwd>
+#include <string>
+#include <cstddef> // for size_t
 #include "midi_file.hpp"
+#include "event_filter.hpp"
+#include "decode_limits.hpp"
+
+/// Options that determine how parse_midifile reads a midi file.
+struct parse_options
+{
+    /// The parse_midifile functions can use one of two interchangeable implementations. Both accept the same files and
+    /// produce identical midi_file structures.
+    enum backend_type
+    {
+        spirit_backend, ///< the boost.spirit grammar.
+        table_backend   ///< the hand-written decoder of midi_decoder.hpp, which dispatches on the status byte.
+    };
+
+    parse_options( backend_type backend = spirit_backend)
+        : backend( backend), threads( 1), capture_sysex( false), skip_corrupt_tracks( false)
+    {
+    }
+
+    backend_type backend;
+
+    /// The number of threads that decode tracks concurrently, zero means one thread per hardware thread.
+    /// With more than one thread, the table decoder is used regardless of the backend setting and every track
+    /// starts without running status. Threads allocate concurrently from the memory resource of the midi_file, so
+    /// that resource must be thread-safe (a std::pmr::monotonic_buffer_resource isn't).
+    unsigned threads;
+
+    /// Whether to store the payload of sysex events in midi_file::sysex_data. If false, sysex events are parsed but
+    /// their payload is dropped. Capturing requires the table decoder, which is used regardless of the backend setting
+    /// when this is set.
+    bool capture_sysex;
+
+    /// The events to keep, by default all events. Rejected events are skipped without building event objects for
+    /// them, but their delta times are added to the next kept event, so kept events keep their correct absolute time.
+    /// A file is rejected if such a sum doesn't fit in a delta time. Rejected events after the last kept event of a
+    /// track are dropped with their time, so a track only keeps its length if its end-of-track event is kept.
+    /// This is considerably faster for tools that only need a part of the file, e.g. event_filter::meta_only() for
+    /// lyrics. Filtering requires the table decoder, which is used regardless of the backend setting when the
+    /// filter doesn't accept all events.
+    event_filter filter;
+
+    /// Limits on the contents of the file, by default none. Use decode_limits::untrusted() for files from unknown
+    /// sources. Files that exceed a limit are rejected as if they were malformed. Limits require the table decoder,
+    /// which is used regardless of the backend setting when any limit is set.
+    decode_limits limits;
+
+    /// Whether to skip damaged chunks instead of rejecting the whole file. The file is first validated with
+    /// validate_midifile(), then the valid tracks are decoded with recover_midifile() (see midi_validator.hpp) on a
+    /// single thread. The file is only rejected if its header is damaged, which includes empty files.
+    bool skip_corrupt_tracks;
+};
 
 /// parse the midi file represented by stream 'stream' and return the information of that file in output parameter 'result'.
 /// This function returns true iff the file could be completely parsed as a midi file.
-bool parse_midifile( std::istream &stream, midi_file &result);
+/// The stream is read into memory completely before parsing, use this overload for pipes and other non-file input.
+bool parse_midifile( std::istream &stream, midi_file &result, const parse_options &options = parse_options());
+
+/// parse the midi file that is stored in memory at [data, data + size).
+/// The bytes are parsed in-place, without copying them first.
+/// If 'result' was constructed with a memory resource, the table decoder allocates all tracks, events and meta data
+/// from that resource. The spirit grammar builds tracks separately and copies them into the file, so only the track
+/// arrays themselves end up in the resource.
+bool parse_midifile( const unsigned char *data, size_t size, midi_file &result, const parse_options &options = parse_options());
+
+/// parse the midi file with name 'filename'.
+/// The file is memory mapped read-only and parsed without copying it. If the file can't be mapped (e.g. because
+/// it is a named pipe) it is read as a stream instead.
+/// This function throws a std::runtime_error if the file cannot be opened.
+bool parse_midifile( const std::string &filename, midi_file &result, const parse_options &options = parse_options());
 
 #endif //MIDI_PARSER_HPP
@@ -0,0 +1,161 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a playback engine that offers the events of a midi file to a sink in real time.
+
+#if !defined( MIDI_PLAYER_HPP)
+#define MIDI_PLAYER_HPP
+
+#include <vector>
+#include <iosfwd>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // for size_t
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+
+/// An event, together with the time at which it should be played.
+struct scheduled_event
+{
+    boost::uint64_t                 due;    ///< microseconds since the start of playback.
+    boost::uint64_t                 tick;   ///< absolute time of the event in ticks.
+    const events::timed_midi_event  *event; ///< the event in the midi_file that is played.
+};
+
+/// Receiver of the events that a midi_player plays.
+/// A sink is offered a batch of events at once: all events that are due within the lookahead window of the player.
+/// Sinks that can schedule output themselves (e.g. with time stamped midi output) should use the due time of every
+/// event, other sinks can simply output the events immediately.
+class playback_sink
+{
+public:
+    virtual ~playback_sink()
+    {
+    }
+
+    /// receive the events [first, first + count) in chronological order. 'now' is the time since the start of playback
+    /// in microseconds at which the batch is sent.
+    virtual void send( const scheduled_event *first, size_t count, boost::uint64_t now) = 0;
+};
+
+/// A sink that drops all events. Useful to measure the timing of the player itself.
+class null_sink : public playback_sink
+{
+public:
+    null_sink()
+        : events( 0), batches( 0)
+    {
+    }
+
+    virtual void send( const scheduled_event *, size_t count, boost::uint64_t)
+    {
+        events += count;
+        ++batches;
+    }
+
+    size_t events;
+    size_t batches;
+};
+
+/// A sink that writes a line of text for every event to a stream: the due time and the send time in microseconds,
+/// the absolute time in ticks and the bytes of the event, as they would be sent to a midi port. For meta events, the
+/// type and the number of data bytes are written instead.
+/// This allows playback to be recorded and inspected without any midi hardware. The stream is flushed after every batch.
+class stream_sink : public playback_sink
+{
+public:
+    explicit stream_sink( std::ostream &output)
+        : output( output)
+    {
+    }
+
+    virtual void send( const scheduled_event *first, size_t count, boost::uint64_t now);
+
+private:
+    std::ostream &output;
+};
+
+/// Timing statistics of a playback run.
+/// The player wakes up once per batch. Jitter is the difference between the time at which the player intended to wake
+/// up and the time at which it actually did. An event is late if it is sent after its due time.
+struct playback_statistics
+{
+    playback_statistics()
+        : events( 0), batches( 0), late_events( 0), max_lateness( 0), max_jitter( 0), total_jitter( 0)
+    {
+    }
+
+    double mean_jitter() const
+    {
+        return batches ? double( total_jitter) / batches : 0.0;
+    }
+
+    size_t          events;
+    size_t          batches;
+    size_t          late_events;
+    boost::uint64_t max_lateness;   ///< in microseconds.
+    boost::uint64_t max_jitter;     ///< in microseconds.
+    boost::uint64_t total_jitter;   ///< sum of the jitter of all wakeups, in microseconds.
+};
+
+/// Options for a midi_player.
+struct player_options
+{
+    player_options()
+        : lookahead( 10000), spin( 500), start_tick( 0)
+    {
+    }
+
+    /// All events that are due within this many microseconds after a wakeup are sent in one batch. The player wakes up
+    /// at most once per lookahead window, so this trades wakeups for the time events are sent ahead of their due time.
+    boost::uint64_t lookahead;
+
+    /// The player sleeps until this many microseconds before a wakeup and then spins on the clock, because sleeping
+    /// alone is not accurate to within a millisecond on most systems. Zero means: only sleep.
+    boost::uint64_t spin;
+
+    /// Playback starts at the first event at or after this time. Due times are relative to this tick.
+    boost::uint64_t start_tick;
+};
+
+/// Plays the events of a midi file against std::chrono::steady_clock.
+/// On construction, the events of all tracks are merged in chronological order and their due times are computed with
+/// the tempo map of the file, so the playback loop only compares times and hands out batches of events.
+/// The midi_file must outlive the player.
+class midi_player
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    explicit midi_player( const midi_file &file, const player_options &options = player_options());
+
+    /// play all events to the sink, returning when the last event was sent or when stop() was called.
+    playback_statistics play( playback_sink &sink);
+
+    /// make a running play() return after the current batch. This can be called from any thread.
+    void stop()
+    {
+        stopped = true;
+    }
+
+    /// the events in the order in which they will be played.
+    const std::vector<scheduled_event> &schedule() const
+    {
+        return events;
+    }
+
+private:
+    /// wait until 'target', return the actual time of waking up. Both are relative to 'start'.
+    boost::uint64_t wait_until( clock_type::time_point start, boost::uint64_t target) const;
+
+    player_options                  options;
+    std::vector<scheduled_event>    events;
+    std::atomic<bool>               stopped;
+};
+
+#endif //MIDI_PLAYER_HPP
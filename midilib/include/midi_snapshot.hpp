@@ -0,0 +1,333 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a binary snapshot format for parsed midi files.
+/// A snapshot is written once from a midi_file and can then be memory mapped and used without parsing: all events are
+/// stored as fixed-width records with their absolute time, and every track is a contiguous range of records.
+/// A snapshot_cache keeps snapshots of midi files on disk, so that opening the same file a second time only maps
+/// its snapshot.
+
+#if !defined( MIDI_SNAPSHOT_HPP)
+#define MIDI_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstddef> // for size_t
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/filesystem/path.hpp>
+#include "midi_file.hpp"
+#include "midi_multiplexer.hpp"
+#include "decode_limits.hpp"
+
+/// The layout of a snapshot file.
+/// A snapshot consists of a file_header, followed by a track_entry for every track, a record for every event, the
+/// payloads of all meta- and sysex events and finally the path of the source file. All fields are stored in the byte
+/// order of the machine that wrote the snapshot. The header, the track entries and the records all have a size that
+/// is a multiple of 8, so in a snapshot that starts on an 8-byte boundary, every track entry and record is aligned.
+/// The payloads and the path are byte strings that need no alignment, and the path starts at an arbitrary offset.
+namespace snapshot_format
+{
+    const char magic[8] = { 'M', 'I', 'D', 'I', 'S', 'N', 'A', 'P'};
+
+    /// incremented whenever the layout changes. Snapshots with another version are not read.
+    const boost::uint32_t version = 1;
+
+    /// written as a native integer, to recognize snapshots that were written with another byte order.
+    const boost::uint32_t byte_order_mark = 0x01020304;
+
+    struct file_header
+    {
+        char            magic[8];
+        boost::uint32_t version;
+        boost::uint32_t byte_order;
+        boost::uint32_t format;             ///< the fields of the midi header.
+        boost::uint32_t number_of_tracks;
+        boost::uint32_t division;
+        boost::uint32_t track_count;        ///< the number of track entries.
+        boost::uint64_t record_count;
+        boost::uint64_t payload_size;
+        boost::uint64_t source_size;        ///< size of the source midi file in bytes.
+        boost::int64_t  source_mtime;       ///< modification time of the source midi file, see snapshot_source.
+        boost::uint32_t source_path_size;
+        boost::uint32_t reserved;
+    };
+
+    /// the range of records that belongs to one track.
+    struct track_entry
+    {
+        boost::uint64_t first_record;
+        boost::uint64_t record_count;
+    };
+
+    /// A single event.
+    /// Channel events store their status byte and data bytes. Meta events have status 0xff and store their type in
+    /// data1, sysex events have status 0xf0 or 0xf7. For both, the payload is a range in the payload section.
+    struct record
+    {
+        boost::uint64_t absolute_time;
+        boost::uint32_t delta_time;
+        boost::uint8_t  status;
+        boost::uint8_t  data1;
+        boost::uint8_t  data2;
+        boost::uint8_t  reserved;
+        boost::uint32_t payload_offset;
+        boost::uint32_t payload_size;
+    };
+}
+
+/// Information about the midi file that a snapshot was made of, used to determine whether a snapshot is up to date.
+struct snapshot_source
+{
+    snapshot_source()
+        : size( 0), mtime( 0)
+    {
+    }
+
+    std::string     path;
+    boost::uint64_t size;
+    boost::int64_t  mtime;  ///< in ticks of std::filesystem::file_time_type, nanoseconds with most standard libraries.
+};
+
+/// A view of the records of a single track in a snapshot.
+/// Iterating over a snapshot track yields timed_midi_event objects, so that the multiplexer and all visitors that work
+/// on midi_tracks can also walk a snapshot. Events are created from their record when an iterator is dereferenced.
+/// Meta events allocate their data bytes, sysex events refer to the payload section of the snapshot.
+/// Records are not checked when a snapshot is attached. A record that a valid snapshot can't hold, i.e. one with a
+/// status byte that is not a channel, meta or sysex status or with a payload range outside of the payload section, is
+/// unpacked as an event without data: an empty 0xf7 sysex packet or an event with an empty payload.
+class snapshot_track
+{
+public:
+    typedef snapshot_format::record record;
+
+    class const_iterator
+        : public boost::iterator_facade<
+            const_iterator,
+            const events::timed_midi_event,
+            boost::random_access_traversal_tag>
+    {
+    public:
+        const_iterator()
+            : current( 0), track( 0), cached( false)
+        {
+        }
+
+        /// copies don't share the unpacked event, they unpack it again when dereferenced.
+        const_iterator( const const_iterator &other)
+            : current( other.current), track( other.track), cached( false)
+        {
+        }
+
+        const_iterator &operator=( const const_iterator &other)
+        {
+            current = other.current;
+            track = other.track;
+            cached = false;
+            return *this;
+        }
+
+        /// the absolute time of the event at the current position. This does not unpack the event.
+        boost::uint64_t absolute_time() const
+        {
+            return current->absolute_time;
+        }
+
+        /// the delta time of the event at the current position. This does not unpack the event.
+        unsigned delta_time() const
+        {
+            return current->delta_time;
+        }
+
+    private:
+        friend class snapshot_track;
+        friend class boost::iterator_core_access;
+
+        const_iterator( const record *current, const snapshot_track *track)
+            : current( current), track( track), cached( false)
+        {
+        }
+
+        const events::timed_midi_event &dereference() const
+        {
+            if (!cached)
+            {
+                track->unpack( *current, event);
+                cached = true;
+            }
+            return event;
+        }
+
+        bool equal( const const_iterator &other) const
+        {
+            return current == other.current;
+        }
+
+        void increment()
+        {
+            ++current;
+            cached = false;
+        }
+
+        void decrement()
+        {
+            --current;
+            cached = false;
+        }
+
+        void advance( std::ptrdiff_t n)
+        {
+            current += n;
+            cached = false;
+        }
+
+        std::ptrdiff_t distance_to( const const_iterator &other) const
+        {
+            return other.current - current;
+        }
+
+        const record                        *current;
+        const snapshot_track                *track;
+        mutable bool                        cached;
+        mutable events::timed_midi_event    event;
+    };
+
+    typedef const_iterator iterator;
+    typedef events::timed_midi_event value_type;
+
+    snapshot_track( const record *first, const record *last, const unsigned char *payload, size_t payload_size)
+        : first( first), last( last), payload( payload), payload_size( payload_size)
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator( first, this);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator( last, this);
+    }
+
+    size_t size() const
+    {
+        return last - first;
+    }
+
+    bool empty() const
+    {
+        return first == last;
+    }
+
+    /// index of the first event at or after the given absolute time, found with a binary search.
+    size_t position( boost::uint64_t time) const;
+
+private:
+    void unpack( const record &r, events::timed_midi_event &result) const;
+
+    const record        *first;
+    const record        *last;
+    const unsigned char *payload;
+    size_t              payload_size;
+};
+
+/// A read-only midi file that is stored in a snapshot.
+/// The snapshot is either memory mapped from a file or attached to a buffer that must outlive the midi_snapshot.
+class midi_snapshot
+{
+public:
+    typedef std::vector<snapshot_track> tracks_type;
+
+    midi_snapshot()
+        : payload( 0)
+    {
+    }
+
+    /// map the snapshot file with the given name.
+    /// Returns false if the file can't be mapped or is not a valid snapshot for this version and byte order.
+    bool open( const std::string &filename);
+
+    /// use the snapshot that is stored in memory at [data, data + size).
+    /// Returns false if the data is not a valid snapshot. data must be aligned on 8 bytes.
+    bool attach( const unsigned char *data, size_t size);
+
+    void close();
+
+    const midi_header &header() const
+    {
+        return snapshot_header;
+    }
+
+    const tracks_type &tracks() const
+    {
+        return snapshot_tracks;
+    }
+
+    const snapshot_source &source() const
+    {
+        return source_info;
+    }
+
+    /// return a pointer to the first byte of the payload of a sysex event that was created by iterating a track of
+    /// this snapshot.
+    const unsigned char *sysex_bytes( const events::sysex &event) const
+    {
+        return payload + event.offset;
+    }
+
+private:
+    boost::iostreams::mapped_file_source    mapping;
+    midi_header                             snapshot_header;
+    tracks_type                             snapshot_tracks;
+    snapshot_source                         source_info;
+    const unsigned char                     *payload;
+};
+
+/// The multiplexer for the tracks of a snapshot.
+typedef basic_midi_multiplexer<midi_snapshot::tracks_type> snapshot_multiplexer;
+
+/// write a snapshot of a midi file to a stream, which must have been opened in binary mode.
+/// Sysex payloads are only stored if they were captured in file.sysex_data.
+/// Returns false if the stream could not be written.
+bool write_snapshot( const midi_file &file, std::ostream &out, const snapshot_source &source = snapshot_source());
+
+/// write a snapshot of a midi file to the file with the given name.
+bool write_snapshot( const midi_file &file, const std::string &filename, const snapshot_source &source = snapshot_source());
+
+/// A directory of snapshots of midi files.
+/// A snapshot is keyed by the path, size and modification time of its source file. Opening a source file for which
+/// an up-to-date snapshot exists only maps that snapshot, otherwise the source file is parsed, a new snapshot is
+/// written and then mapped.
+/// The modification time is taken with the full resolution of the file system, not in seconds, so a file that is
+/// rewritten with the same size shortly after it was cached is still recognized as changed. On file systems with a
+/// coarse timestamp resolution (e.g. two seconds on FAT), a rewrite within that resolution can go unnoticed.
+/// Several processes can share a cache directory: snapshots are written to a temporary file that is then renamed.
+class snapshot_cache
+{
+public:
+    /// use the given directory for snapshots, it is created if it doesn't exist.
+    /// Source files are parsed with the given limits, see parse_options::limits.
+    explicit snapshot_cache( const std::string &directory, const decode_limits &limits = decode_limits());
+
+    /// open the snapshot of the midi file at 'path'.
+    /// Returns false if the file is not a valid midi file or exceeds the limits. Throws a std::runtime_error if the
+    /// file can't be read.
+    bool open( const std::string &path, midi_snapshot &result) const;
+
+    /// the name of the snapshot file for the midi file at 'path'.
+    std::string snapshot_path( const std::string &path) const;
+
+private:
+    boost::filesystem::path directory;
+    decode_limits           limits;
+};
+
+#endif //MIDI_SNAPSHOT_HPP
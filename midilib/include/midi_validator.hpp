@@ -0,0 +1,80 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( MIDI_VALIDATOR_HPP)
+#define MIDI_VALIDATOR_HPP
+#include <string>
+#include <vector>
+#include <cstddef> // for size_t
+#include "midi_file.hpp"
+#include "midi_parser.hpp"
+
+/// What validate_midifile found out about a single chunk after the header chunk.
+struct chunk_validation
+{
+    enum status_type
+    {
+        valid_track,        ///< a track chunk, with well-formed events if those were checked.
+        malformed_track,    ///< a track chunk with events that can't be decoded.
+        truncated_track,    ///< a track chunk that extends beyond the end of the input or into the next track chunk.
+        foreign_chunk       ///< a chunk with another signature than "MTrk", which the parser doesn't accept.
+    };
+
+    status_type status;
+    size_t      offset;     ///< the offset of the chunk data in the file, just after the chunk header.
+    size_t      size;       ///< the number of data bytes that are actually present, which is less than the chunk size for truncated tracks.
+    size_t      events;     ///< the number of events in a valid track, or zero if events weren't checked.
+};
+
+/// The result of validate_midifile: the structure of a file, as far as it could be determined.
+struct midi_validation
+{
+    typedef std::vector<chunk_validation> chunks_type;
+
+    midi_validation()
+        : header_valid( false), skipped_bytes( 0)
+    {
+    }
+
+    /// true if the file is a midi file in which every chunk is a valid track and the number of tracks matches the
+    /// header. This is slightly stricter than parse_midifile(), which doesn't check the number of tracks.
+    bool valid() const;
+
+    /// the number of chunks with status valid_track.
+    size_t valid_tracks() const;
+
+    /// true if the header is valid and its number_of_tracks equals the number of track chunks, whatever their status.
+    bool track_count_consistent() const;
+
+    bool        header_valid;   ///< false if the input doesn't start with a well-formed header chunk, nothing else is checked then.
+    midi_header header;
+    chunks_type chunks;
+    size_t      skipped_bytes;  ///< bytes that aren't part of any chunk, e.g. garbage between tracks.
+};
+
+/// Determine the structure of the midi file in memory at [data, data + size) without decoding it.
+/// Only the header chunk and the chunk headers are read, which takes hardly any time at all. Where a chunk header
+/// is damaged, the validator searches for the next "MTrk" signature to find the next track.
+/// If check_events is true, the events of every track are also walked to check that delta times, lengths and
+/// running status are well-formed, without building any events. Just like the parser, the running status is kept
+/// across track boundaries.
+midi_validation validate_midifile( const unsigned char *data, size_t size, bool check_events = false);
+
+/// Determine the structure of the midi file with the given name, see above.
+/// This function throws a std::runtime_error if the file cannot be opened.
+midi_validation validate_midifile( const std::string &filename, bool check_events = false);
+
+/// Decode the tracks of the midi file at [data, data + size) that 'validation' found to be valid, and skip all other
+/// chunks. Tracks that can't be decoded after all, or that exceed options.limits, are skipped too and are marked as
+/// malformed in 'validation'. A skipped track doesn't count against the memory limit of the tracks that follow.
+/// The running status is kept across tracks, but not across skipped tracks. Tracks are decoded on a single thread,
+/// whatever the thread setting in options.
+/// 'validation' must be the result of validate_midifile() for the same data. Returns false iff the header is invalid.
+bool recover_midifile( const unsigned char *data, size_t size, midi_validation &validation, midi_file &result, const parse_options &options = parse_options());
+
+#endif //MIDI_VALIDATOR_HPP
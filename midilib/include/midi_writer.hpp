@@ -0,0 +1,58 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains functions that write a midi_file back out as a standard midi file.
+
+#if !defined( MIDI_WRITER_HPP)
+#define MIDI_WRITER_HPP
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <cstddef> // for size_t
+#include "midi_file.hpp"
+
+/// Options that determine how write_midifile encodes a midi file.
+struct write_options
+{
+    write_options()
+        : running_status( true)
+    {
+    }
+
+    /// Whether to leave out the status byte of a channel event if it is the same as that of the previous channel
+    /// event in the track. Meta- and sysex events cancel running status, as the standard midi file specification
+    /// prescribes, so the output can be read by any midi file reader.
+    bool running_status;
+};
+
+/// Return the number of bytes that write_midifile would produce for the given file.
+/// Throws std::out_of_range if the file holds a channel event that can't be written, see write_midifile.
+size_t midifile_size( const midi_file &file, const write_options &options = write_options());
+
+/// Encode a midi file as a standard midi file and replace the contents of 'buffer' with the result.
+/// The buffer is sized once and then filled, there is no per-event overhead.
+/// The number of tracks in the header is the number of tracks in file.tracks, the other header fields are copied.
+/// The events are written as they are, so every track should end with an end-of-track meta event. Tracks without
+/// any events get a single end-of-track event, because a track chunk must contain at least one event.
+/// Sysex payloads are taken from file.sysex_data, so they are only written if they were captured while parsing.
+/// Channel numbers must be below 16 and all other channel event values below 128. A pitch bend value holds its two
+/// data bytes as its low and high byte, as the parsers store it, so neither byte may be above 127.
+/// A value out of range, e.g. a note number of 130 after transposing, makes this function throw std::out_of_range,
+/// in which case 'buffer' is left unchanged. The overloads below throw the same exception before anything is written.
+void write_midifile( const midi_file &file, std::vector<unsigned char> &buffer, const write_options &options = write_options());
+
+/// Write a midi file to a stream, which must have been opened in binary mode.
+/// Returns false if the stream could not be written.
+bool write_midifile( const midi_file &file, std::ostream &stream, const write_options &options = write_options());
+
+/// Write a midi file to the file with the given name.
+/// This function throws a std::runtime_error if the file cannot be opened and returns false if it could not be
+/// written completely.
+bool write_midifile( const midi_file &file, const std::string &filename, const write_options &options = write_options());
+
+#endif //MIDI_WRITER_HPP
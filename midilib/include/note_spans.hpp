@@ -0,0 +1,141 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains functions to pair the note-on and note-off events of a midi file into notes with a duration,
+/// and an index that finds the notes that sound in any time window.
+
+#if !defined( NOTE_SPANS_HPP)
+#define NOTE_SPANS_HPP
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+
+/// A note from its note-on event up to its note-off event.
+struct note_span
+{
+    typedef boost::uint64_t tick_type;
+
+    tick_type       start;      ///< absolute time of the note-on event.
+    tick_type       end;        ///< absolute time of the note-off event.
+    boost::uint32_t track;
+    unsigned char   channel;
+    unsigned char   key;
+    unsigned char   velocity;   ///< the velocity of the note-on event.
+};
+
+typedef std::vector<note_span> note_span_vector;
+
+/// find all notes in a midi file and store them in 'result', ordered by start time and, for simultaneous notes, by
+/// track, just like a midi_multiplexer would offer their note-on events.
+/// Notes are paired within a track, per channel and key. A note-on event with velocity zero counts as a note-off
+/// event. If a key is struck again while it sounds, the next note-off event ends the earliest note. Notes that are
+/// never ended last until the last event of the file, note-off events without a note are ignored.
+void extract_note_spans( const midi_file &file, note_span_vector &result);
+
+/// An interval tree on note spans that finds all notes that sound during a time window in O(log n + k) time for k
+/// notes found.
+/// Every node of the tree has a center time and holds the notes that sound at that time, once ordered by start and
+/// once ordered by end time, so that a query only looks at the notes that it reports plus one note per node on the
+/// path through the tree. Notes that end before the center go to the left subtree, notes that start after it go to
+/// the right subtree. All nodes and all node lists are stored in flat arrays.
+/// The index holds a copy of the notes. It is never modified after construction, so any number of threads can query
+/// it concurrently.
+class note_span_index
+{
+public:
+    typedef note_span::tick_type tick_type;
+
+    explicit note_span_index( const note_span_vector &notes);
+
+    const note_span_vector &notes() const
+    {
+        return spans;
+    }
+
+    /// call f( note) for every note that sounds at some time in [first, last), in no particular order.
+    /// A note sounds from its start up to, but not including, its end. Notes without duration are taken to sound
+    /// during their start tick.
+    template<typename Function>
+    void query( tick_type first, tick_type last, Function f) const
+    {
+        if (first < last && !nodes.empty()) query( 0, first, last, f);
+    }
+
+    /// append the indices in notes() of all notes that sound at some time in [first, last) to 'result'.
+    void find( tick_type first, tick_type last, std::vector<size_t> &result) const;
+
+    /// append the indices in notes() of all notes that sound at the given tick to 'result'.
+    void find( tick_type tick, std::vector<size_t> &result) const
+    {
+        find( tick, tick + 1, result);
+    }
+
+private:
+    static const boost::uint32_t no_node = 0xffffffff;
+
+    /// A note in the list of a node, with the time on which that list is ordered.
+    struct entry
+    {
+        tick_type       time;
+        boost::uint32_t note;
+    };
+
+    struct node
+    {
+        tick_type       center;
+        boost::uint32_t left;
+        boost::uint32_t right;
+        boost::uint32_t begin;  ///< the notes of this node are at [begin, end) in by_start and by_end.
+        boost::uint32_t end;
+    };
+
+    boost::uint32_t build( std::vector<boost::uint32_t> &notes);
+
+    template<typename Function>
+    void query( boost::uint32_t index, tick_type first, tick_type last, Function &f) const
+    {
+        // all notes of a node sound at its center.
+        const node &current = nodes[index];
+        if (last <= current.center)
+        {
+            // the window lies before the center, notes that start before the end of the window overlap it.
+            for (boost::uint32_t i = current.begin; i != current.end && by_start[i].time < last; ++i)
+            {
+                f( spans[by_start[i].note]);
+            }
+            if (current.left != no_node) query( current.left, first, last, f);
+        }
+        else if (first > current.center)
+        {
+            // the window lies after the center, notes that end after the start of the window overlap it.
+            for (boost::uint32_t i = current.begin; i != current.end && by_end[i].time > first; ++i)
+            {
+                f( spans[by_end[i].note]);
+            }
+            if (current.right != no_node) query( current.right, first, last, f);
+        }
+        else
+        {
+            // the window contains the center.
+            for (boost::uint32_t i = current.begin; i != current.end; ++i)
+            {
+                f( spans[by_start[i].note]);
+            }
+            if (current.left != no_node) query( current.left, first, last, f);
+            if (current.right != no_node) query( current.right, first, last, f);
+        }
+    }
+
+    note_span_vector    spans;
+    std::vector<node>   nodes;      ///< the root, if any, is at index zero.
+    std::vector<entry>  by_start;   ///< per node: its notes in ascending order of start time.
+    std::vector<entry>  by_end;     ///< per node: its notes in descending order of end time.
+};
+
+#endif //NOTE_SPANS_HPP
@@ -0,0 +1,263 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a compact, read-only alternative to midi_file.
+/// Where a midi_track stores a timed_midi_event (with nested variants and a vector per meta event) for every event,
+/// a packed_midi_track stores parallel arrays of delta times, status bytes and data bytes. The payload of meta- and
+/// sysex events is stored in a single byte arena that is shared by all tracks of a file.
+/// Sysex payloads are always stored. The sysex events that the iterators create refer to the arena of the packed file.
+
+#if !defined( PACKED_MIDI_FILE_HPP)
+#define PACKED_MIDI_FILE_HPP
+#include <vector>
+#include <iterator>
+#include <cstddef> // for size_t
+#include <boost/shared_ptr.hpp>
+#include "midi_file.hpp"
+#include "midi_decoder.hpp"
+
+/// A track of midi events in structure-of-arrays form.
+/// Channel events take seven bytes per event, meta- and sysex events take another eight bytes for a reference to their
+/// payload.
+/// Iterating over a packed track yields timed_midi_event objects, so that any visitor that works on midi_tracks can also
+/// walk a packed track.
+class packed_midi_track
+{
+public:
+    typedef std::vector<unsigned char> arena_type;
+
+    /// reference to the payload of a meta- or sysex event in the arena.
+    struct payload_ref
+    {
+        unsigned offset;
+        unsigned size;
+    };
+
+    /// Forward iterator that re-creates timed_midi_events from the packed representation.
+    /// The event is created when the iterator is first dereferenced at a position, and stays valid until the iterator
+    /// is moved.
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag           iterator_category;
+        typedef events::timed_midi_event            value_type;
+        typedef std::ptrdiff_t                      difference_type;
+        typedef const events::timed_midi_event *    pointer;
+        typedef const events::timed_midi_event &    reference;
+
+        const_iterator()
+            : track( 0), index( 0), payload_index( 0), cached( false)
+        {
+        }
+
+        reference operator*() const
+        {
+            if (!cached)
+            {
+                track->unpack( index, payload_index, current);
+                cached = true;
+            }
+            return current;
+        }
+
+        pointer operator->() const
+        {
+            return &**this;
+        }
+
+        /// The delta time of the event at the current position. Unlike operator*, this does not unpack the event.
+        unsigned delta_time() const
+        {
+            return track->delta_times[index];
+        }
+
+        const_iterator &operator++()
+        {
+            if (track->has_payload( index)) ++payload_index;
+            ++index;
+            cached = false;
+            return *this;
+        }
+
+        const_iterator operator++( int)
+        {
+            const_iterator previous( *this);
+            ++*this;
+            return previous;
+        }
+
+        bool operator==( const const_iterator &other) const
+        {
+            return index == other.index && track == other.track;
+        }
+
+        bool operator!=( const const_iterator &other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        friend class packed_midi_track;
+        const_iterator( const packed_midi_track *track, size_t index, size_t payload_index)
+            : track( track), index( index), payload_index( payload_index), cached( false)
+        {
+        }
+
+        const packed_midi_track *track;
+        size_t index;
+        size_t payload_index;
+        mutable bool cached;
+        mutable events::timed_midi_event current;
+    };
+
+    typedef const_iterator iterator;
+    typedef events::timed_midi_event value_type;
+
+    const_iterator begin() const
+    {
+        return const_iterator( this, 0, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator( this, size(), payloads.size());
+    }
+
+    size_t size() const
+    {
+        return delta_times.size();
+    }
+
+    bool empty() const
+    {
+        return delta_times.empty();
+    }
+
+    /// The number of bytes allocated for this track, not counting the shared arena.
+    size_t memory_usage() const
+    {
+        return delta_times.capacity() * sizeof( unsigned)
+            + statuses.capacity()
+            + data.capacity()
+            + payloads.capacity() * sizeof( payload_ref);
+    }
+
+    /// Append a channel event.
+    void push_channel_event( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+    {
+        push( delta_time, status, data1, data2);
+    }
+
+    /// Append a meta- or sysex event. status must be 0xff for meta events and 0xf0 or 0xf7 for sysex events.
+    /// type is the meta event type and is ignored for sysex events.
+    /// The payload is appended to the arena.
+    void push_payload_event( unsigned delta_time, unsigned char status, unsigned char type, const unsigned char *payload, size_t size, arena_type &arena)
+    {
+        payload_ref ref;
+        ref.offset = static_cast<unsigned>( arena.size());
+        ref.size = static_cast<unsigned>( size);
+        arena.insert( arena.end(), payload, payload + size);
+        payloads.push_back( ref);
+        push( delta_time, status, type, 0);
+    }
+
+    /// Release any excess capacity and connect the track to the (now complete) arena.
+    /// This must be called after the last event was pushed and before the track is iterated.
+    void freeze( const boost::shared_ptr<const arena_type> &shared_arena)
+    {
+        std::vector<unsigned>( delta_times).swap( delta_times);
+        std::vector<unsigned char>( statuses).swap( statuses);
+        std::vector<unsigned char>( data).swap( data);
+        std::vector<payload_ref>( payloads).swap( payloads);
+        arena = shared_arena;
+    }
+
+private:
+    void push( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+    {
+        delta_times.push_back( delta_time);
+        statuses.push_back( status);
+        data.push_back( data1);
+        data.push_back( data2);
+    }
+
+    bool has_payload( size_t index) const
+    {
+        return statuses[index] >= 0xf0;
+    }
+
+    /// re-create the timed_midi_event at the given index.
+    void unpack( size_t index, size_t payload_index, events::timed_midi_event &result) const
+    {
+        result.delta_time = delta_times[index];
+        const unsigned char status = statuses[index];
+        if (status == 0xff)
+        {
+            result.event = events::meta();
+            events::meta &meta = boost::get<events::meta>( result.event);
+            meta.type = data[2 * index];
+            const payload_ref &ref = payloads[payload_index];
+            const unsigned char *payload = arena->empty() ? 0 : &(*arena)[0] + ref.offset;
+            meta.bytes.assign( payload, payload + ref.size);
+        }
+        else if (status >= 0xf0)
+        {
+            events::sysex sysex;
+            sysex.status = status;
+            sysex.offset = payloads[payload_index].offset;
+            sysex.size = payloads[payload_index].size;
+            result.event = sysex;
+        }
+        else
+        {
+            events::channel_event event;
+            decoding::make_channel_event( status, data[2 * index], data[2 * index + 1], event);
+            result.event = event;
+        }
+    }
+
+    std::vector<unsigned>       delta_times;
+    std::vector<unsigned char>  statuses;   ///< status byte per event. 0xff for meta events, 0xf0 or 0xf7 for sysex.
+    std::vector<unsigned char>  data;       ///< two data bytes per event. For meta events, the first byte is the meta type.
+    std::vector<payload_ref>    payloads;   ///< payload references for meta- and sysex events, in event order.
+    boost::shared_ptr<const arena_type> arena;
+};
+
+/// In-memory representation of a midi file, using packed tracks.
+struct packed_midi_file
+{
+    typedef std::vector<packed_midi_track> tracks_type;
+
+    packed_midi_file()
+    {
+    }
+
+    /// create a packed copy of a midi_file.
+    /// Sysex payloads are copied from file.sysex_data.
+    explicit packed_midi_file( const midi_file &file);
+
+    midi_header header;
+    tracks_type tracks;
+    boost::shared_ptr<const packed_midi_track::arena_type> arena;
+
+    /// The number of bytes allocated for all tracks and the arena.
+    size_t memory_usage() const;
+
+    /// return a pointer to the first byte of the payload of a sysex event that was created by iterating a track of
+    /// this file.
+    const unsigned char *sysex_bytes( const events::sysex &event) const
+    {
+        return (!arena || arena->empty()) ? 0 : &(*arena)[0] + event.offset;
+    }
+};
+
+/// Decode the midi file at [data, data + size) directly into a packed_midi_file, without creating a midi_file first.
+/// Returns true iff the complete input could be decoded.
+bool decode_packed_midifile( const unsigned char *data, size_t size, packed_midi_file &result);
+
+#endif //PACKED_MIDI_FILE_HPP
@@ -0,0 +1,174 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a parsed midi file that can be shared by any number of threads, with cursors that each walk
+/// through the file independently.
+
+#if !defined( SHARED_MIDI_FILE_HPP)
+#define SHARED_MIDI_FILE_HPP
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+#include "midi_parser.hpp"
+#include "midi_index.hpp"
+#include "tempo_map.hpp"
+
+class midi_cursor;
+
+/// A parsed midi file together with its midi_index, which is never modified after construction.
+/// Shared files are always owned by a std::shared_ptr. All member functions are const and can be called concurrently,
+/// so one copy of a file in memory can serve any number of playback sessions, each with their own midi_cursor.
+class shared_midi_file : public std::enable_shared_from_this<shared_midi_file>
+{
+public:
+    typedef boost::uint64_t                         tick_type;
+    typedef std::shared_ptr<const shared_midi_file> pointer;
+
+    /// take over a parsed file. If the file was parsed into a memory resource, that resource must outlive the
+    /// shared file.
+    static pointer create( midi_file &&file);
+
+    /// parse the file with the given name.
+    /// Throws a std::runtime_error if the file can't be opened or isn't a valid midi file.
+    static pointer load( const std::string &filename, const parse_options &options = parse_options());
+
+    const midi_file &file() const
+    {
+        return parsed_file;
+    }
+
+    const midi_index &index() const
+    {
+        return file_index;
+    }
+
+    const tempo_map &tempos() const
+    {
+        return file_index.tempos();
+    }
+
+    /// a cursor that offers the events of this file, starting at the given time.
+    midi_cursor cursor( tick_type tick = 0) const;
+
+private:
+    explicit shared_midi_file( midi_file &&file);
+    shared_midi_file( const shared_midi_file &);
+    shared_midi_file &operator=( const shared_midi_file &);
+
+    const midi_file     parsed_file;
+    const midi_index    file_index; ///< refers to parsed_file, which is why shared files can't be copied or moved.
+};
+
+/// A position in a shared_midi_file, from which the events of all tracks are offered in the same order as a
+/// midi_multiplexer would offer them.
+/// A cursor holds a reference to its file, the position in each track and the time of the last event offered. It
+/// doesn't change the file, so any number of cursors on the same file can be used concurrently, but a single cursor
+/// must not be used by several threads at the same time. Cursors are cheap to copy, a copy continues at the same
+/// position independently of the original. This makes it easy to pause a session (keep the cursor) and to resume it
+/// later.
+/// Just like the multiplexer, a cursor keeps the tracks with events left in a min-heap, ordered on the time of their
+/// next event, so next() takes O(log(number of tracks)). A cursor holds O(tracks) memory, which is also the cost of
+/// copying it.
+class midi_cursor
+{
+public:
+    typedef shared_midi_file::tick_type         tick_type;
+    typedef midi_index::positions_type          positions_type;
+
+    /// a cursor on the given file at the given time, see shared_midi_file::cursor().
+    midi_cursor( const shared_midi_file::pointer &file, tick_type tick);
+
+    const shared_midi_file &file() const
+    {
+        return *shared_file;
+    }
+
+    /// true if all events have been offered.
+    bool at_end() const
+    {
+        return upcoming.empty();
+    }
+
+    /// the next event, without advancing the cursor. Its delta time is relative to tick().
+    /// Precondition: !at_end().
+    events::timed_midi_event_ref peek() const;
+
+    /// the track of the next event. Precondition: !at_end().
+    size_t peek_track() const
+    {
+        return upcoming.front();
+    }
+
+    /// the next event, after which the cursor advances to the event after it, in O(log(number of tracks)). Its delta
+    /// time is relative to the previous event offered or, right after construction or seek(), to the time that was
+    /// sought.
+    /// Precondition: !at_end().
+    events::timed_midi_event_ref next();
+
+    /// continue with the first events at or after the given time, in O(tracks * log n).
+    void seek( tick_type tick);
+
+    /// continue with the first events at or after the given time in seconds.
+    void seek_seconds( double seconds)
+    {
+        seek( shared_file->tempos().seconds_to_ticks( seconds));
+    }
+
+    /// the time of the last event offered, or the time that was sought.
+    tick_type tick() const
+    {
+        return current_tick;
+    }
+
+    /// tick() in seconds since the start of the file.
+    double seconds() const
+    {
+        return shared_file->tempos().ticks_to_seconds( current_tick);
+    }
+
+    /// the tempo at tick() in microseconds per quarter note.
+    unsigned tempo() const
+    {
+        return shared_file->tempos().tempo_at( current_tick);
+    }
+
+    /// the state of all channels after all events before tick(), e.g. to send to a synthesizer when a session
+    /// starts or resumes in the middle of a file.
+    playback_state state() const
+    {
+        return shared_file->index().state_at( current_tick);
+    }
+
+private:
+    /// heap ordering on track indices: a track comes later than another if its next event is later, or if it is
+    /// simultaneous and the track has a higher index.
+    struct later
+    {
+        explicit later( const positions_type &positions)
+            : positions( positions)
+        {
+        }
+
+        bool operator()( size_t lhs, size_t rhs) const
+        {
+            return positions[lhs].time > positions[rhs].time || (positions[lhs].time == positions[rhs].time && lhs > rhs);
+        }
+
+        const positions_type &positions;
+    };
+
+    shared_midi_file::pointer   shared_file;
+    positions_type              positions;      ///< per track, the index and time of its next event.
+    tick_type                   current_tick;
+    std::vector<size_t>         upcoming;       ///< min-heap of the tracks with events left, see later.
+};
+
+#endif //SHARED_MIDI_FILE_HPP
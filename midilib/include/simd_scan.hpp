@@ -0,0 +1,54 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains vectorized scanning functions for midi data: bulk decoding of variable length quantities and
+/// searching for chunk signatures. Every function has a scalar implementation and, on x86 processors, SSE2 and AVX2
+/// implementations. The fastest implementation that the processor supports is selected at runtime.
+
+#if !defined( SIMD_SCAN_HPP)
+#define SIMD_SCAN_HPP
+#include <cstddef> // for size_t
+#include <boost/cstdint.hpp>
+
+namespace decoding
+{
+    namespace simd
+    {
+        typedef const unsigned char *byte_iterator;
+
+        enum instruction_set
+        {
+            scalar_instructions,
+            sse2_instructions,
+            avx2_instructions
+        };
+
+        /// the best instruction set that is supported by both this build and the processor. This is determined once.
+        instruction_set best_instruction_set();
+
+        /// the name of an instruction set, for reporting.
+        const char *instruction_set_name( instruction_set instructions);
+
+        /// decode up to 'count' consecutive variable length quantities starting at 'first' into 'out'.
+        /// Decoding stops early when the input ends in the middle of a quantity. 'end' is set to just after the last
+        /// decoded quantity. Values that don't fit in 32 bits are truncated, standard midi files never use more
+        /// than four bytes (28 bits) per quantity.
+        /// Returns the number of decoded quantities.
+        size_t decode_variable_length_quantities(
+            byte_iterator first, byte_iterator last, boost::uint32_t *out, size_t count, byte_iterator &end,
+            instruction_set instructions = best_instruction_set());
+
+        /// find the first occurrence of a four character signature (e.g. "MTrk") in [first, last).
+        /// Returns last if the signature does not occur.
+        byte_iterator find_signature(
+            byte_iterator first, byte_iterator last, const char *signature,
+            instruction_set instructions = best_instruction_set());
+    }
+}
+
+#endif //SIMD_SCAN_HPP
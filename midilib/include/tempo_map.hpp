@@ -0,0 +1,96 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains a tempo map, which converts between midi time stamps (ticks) and wall-clock time.
+
+#if !defined( TEMPO_MAP_HPP)
+#define TEMPO_MAP_HPP
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "midi_file.hpp"
+
+/// The tempo changes of a midi file, precomputed so that any time stamp can be converted to and from wall-clock time
+/// without visiting the events of the file.
+/// For files with a PPQ time division (ticks per quarter note), the map holds a sorted list of segments of constant
+/// tempo. A conversion finds the segment with a binary search. For files with an SMPTE time division, the duration of a
+/// tick is fixed and tempo meta events are ignored.
+/// All arithmetic is done in integer microseconds, so conversions are deterministic and do not accumulate rounding
+/// errors over the length of a file.
+class tempo_map
+{
+public:
+    typedef boost::uint64_t tick_type;
+
+    /// A period of constant tempo.
+    struct segment
+    {
+        tick_type       tick;           ///< start of the segment.
+        boost::uint64_t microseconds;   ///< start of the segment in microseconds since the start of the file.
+        unsigned        tempo;          ///< microseconds per quarter note.
+    };
+    typedef std::vector<segment> segments_type;
+
+    /// the tempo of a file without tempo events: 120 quarter notes per minute.
+    static const unsigned default_tempo = 500000;
+
+    /// build the tempo map of a file from the tempo meta events (type 81) in all of its tracks.
+    explicit tempo_map( const midi_file &file);
+
+    /// create a tempo map for the given header without any tempo changes.
+    explicit tempo_map( const midi_header &header);
+
+    /// add a tempo change. Changes must be added in chronological order, a change replaces an earlier
+    /// change at the same time.
+    void add_tempo_change( tick_type tick, unsigned tempo);
+
+    /// convert an absolute time in ticks to microseconds since the start of the file, rounded down.
+    boost::uint64_t ticks_to_microseconds( tick_type tick) const;
+
+    /// convert microseconds since the start of the file to the last tick at or before that time.
+    /// This is the inverse of ticks_to_microseconds(): ticks_to_microseconds( microseconds_to_ticks( us)) <= us.
+    tick_type microseconds_to_ticks( boost::uint64_t microseconds) const;
+
+    /// convert an absolute time in ticks to seconds since the start of the file.
+    double ticks_to_seconds( tick_type tick) const
+    {
+        return ticks_to_microseconds( tick) / 1000000.0;
+    }
+
+    /// convert seconds since the start of the file to the last tick at or before that time.
+    tick_type seconds_to_ticks( double seconds) const
+    {
+        return microseconds_to_ticks( seconds > 0 ? static_cast<boost::uint64_t>( seconds * 1000000.0 + 0.5) : 0);
+    }
+
+    /// the tempo in microseconds per quarter note at the given time.
+    unsigned tempo_at( tick_type tick) const
+    {
+        return find_segment( tick).tempo;
+    }
+
+    /// true if the file uses SMPTE time division, in which case tempo changes are ignored.
+    bool is_smpte() const
+    {
+        return ticks_per_100_seconds != 0;
+    }
+
+    const segments_type &segments() const
+    {
+        return tempo_segments;
+    }
+
+private:
+    const segment &find_segment( tick_type tick) const;
+
+    unsigned        division;               ///< ticks per quarter note, for PPQ time division.
+    boost::uint64_t ticks_per_100_seconds;  ///< for SMPTE time division, zero otherwise.
+    segments_type   tempo_segments;
+};
+
+#endif //TEMPO_MAP_HPP
@@ -26,11 +26,11 @@ namespace events
         {
             if (h.division & 0x8000)
             {
-                // if the msb is set, we interpret the top byte as frames per second (fps) and the
+                // if the msb is set, we interpret the top byte as negated frames per second (fps) and the
                 // bottom byte as ticks per frame.
-                int fps_raw = (h.division & 0x7f00) >> 8;
+                int fps_raw = 0x100 - ((h.division >> 8) & 0xff);
                 double fps = (fps_raw == 29)?29.97:fps_raw;
-                time_step = fps * (h.division & 0x00ff);
+                time_step = 1.0 / (fps * (h.division & 0x00ff));
                 ignore_bpm = true;
             }
             else
@@ -52,6 +52,13 @@ namespace events
             derived()( event.event);
         }
 
+        /// visit a view of a timed midi event, using the delta time of the view.
+        void operator()( const timed_midi_event_ref &event)
+        {
+            current_time += (event.delta_time * time_step);
+            derived()( event.event.event);
+        }
+
         /// visit a meta event.
         /// If the event is a tempo change. This object will react on that.
         void operator() (const meta &event)
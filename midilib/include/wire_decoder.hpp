@@ -0,0 +1,198 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// This file contains an incremental decoder for midi as it is sent over a wire (a serial port, a raw midi device, a
+/// pipe or a socket), as opposed to the standard midi files that midi_decoder.hpp reads.
+/// On the wire there are no delta times and no meta events, realtime messages (0xf8-0xff) may appear anywhere, even
+/// in the middle of another message, and any read may end halfway through a message.
+
+#if !defined( WIRE_DECODER_HPP)
+#define WIRE_DECODER_HPP
+#include <cstddef> // for size_t
+#include <vector>
+#include "midi_event_types.hpp"
+#include "midi_decoder.hpp"
+
+namespace decoding
+{
+    /// Decodes midi wire bytes that arrive in chunks of any size.
+    /// The running status and any partially received message are kept between calls to decode(), so that a message
+    /// may be split over any number of chunks. For every complete message, the corresponding member function of the
+    /// handler is called:
+    ///  * handler.channel_event( const events::channel_event &) for note, controller, program, aftertouch and pitch bend messages,
+    ///  * handler.sysex_event( const events::sysex &, byte_iterator payload) for system exclusive messages,
+    ///  * handler.system_common_event( status, data1, data2) for the system common messages 0xf1, 0xf2, 0xf3 and 0xf6,
+    ///  * handler.realtime_event( status) for the single byte realtime messages 0xf8-0xff, as soon as they arrive.
+    ///
+    /// Sysex payloads are collected in a buffer of fixed capacity. Just like in a midi file, a complete message has
+    /// status 0xf0 and its payload ends with 0xf7. A message that doesn't fit is passed on in packets: the first has
+    /// status 0xf0, the following ones have status 0xf7 and only the last ends with 0xf7. A sysex message that is
+    /// interrupted by another status byte is passed on without the final 0xf7. The offset of every sysex event is
+    /// zero, the payload pointer is only valid during the call.
+    ///
+    /// All memory is allocated in the constructor, decoding never allocates.
+    template<typename Handler>
+    class wire_decoder
+    {
+    public:
+        static const size_t default_sysex_capacity = 1024;
+
+        explicit wire_decoder( Handler &handler, size_t sysex_capacity = default_sysex_capacity)
+            : handler( handler), status( 0), expected( 0), received( 0),
+              in_sysex( false), sysex_status( 0xf0), sysex_size( 0), sysex_buffer( sysex_capacity ? sysex_capacity : 1),
+              dropped( 0)
+        {
+        }
+
+        /// decode the bytes in [first, last), which follow the bytes of the previous call.
+        void decode( byte_iterator first, byte_iterator last)
+        {
+            for (; first != last; ++first)
+            {
+                const unsigned char byte = *first;
+                if (byte < 0x80)
+                {
+                    data_byte( byte);
+                }
+                else if (byte >= 0xf8)
+                {
+                    handler.realtime_event( byte);
+                }
+                else
+                {
+                    status_byte( byte);
+                }
+            }
+        }
+
+        /// forget the running status and any partially received message, e.g. after reconnecting.
+        void reset()
+        {
+            status = 0;
+            expected = 0;
+            received = 0;
+            in_sysex = false;
+            sysex_size = 0;
+        }
+
+        /// the number of data bytes that were ignored, because they didn't belong to any message. This happens when
+        /// decoding starts in the middle of a message or when a message is interrupted by another one.
+        size_t dropped_bytes() const
+        {
+            return dropped;
+        }
+
+    private:
+        /// the number of data bytes after a system common status byte.
+        static unsigned system_common_length( unsigned char status)
+        {
+            switch (status)
+            {
+            case 0xf1: return 1; // midi time code quarter frame
+            case 0xf2: return 2; // song position pointer
+            case 0xf3: return 1; // song select
+            default:   return 0; // tune request and the undefined 0xf4 and 0xf5.
+            }
+        }
+
+        void data_byte( unsigned char byte)
+        {
+            if (in_sysex)
+            {
+                append_sysex( byte);
+            }
+            else if (expected == 0)
+            {
+                ++dropped;
+            }
+            else
+            {
+                data[received++] = byte;
+                if (received == expected)
+                {
+                    received = 0;
+                    const unsigned char data2 = expected == 2 ? data[1] : 0;
+                    if (status < 0xf0)
+                    {
+                        // channel messages leave the running status in place.
+                        events::channel_event event;
+                        make_channel_event( status, data[0], data2, event);
+                        handler.channel_event( event);
+                    }
+                    else
+                    {
+                        expected = 0;
+                        handler.system_common_event( status, data[0], data2);
+                    }
+                }
+            }
+        }
+
+        /// any status byte, except a realtime status byte, ends a sysex message and cancels the running status.
+        void status_byte( unsigned char byte)
+        {
+            if (in_sysex)
+            {
+                if (byte == 0xf7) append_sysex( byte);
+                flush_sysex();
+                in_sysex = false;
+            }
+            dropped += received;
+            received = 0;
+
+            status = byte;
+            if (byte < 0xf0)
+            {
+                expected = channel_event_length[ byte >> 4];
+            }
+            else if (byte == 0xf0)
+            {
+                expected = 0;
+                in_sysex = true;
+                sysex_status = 0xf0;
+            }
+            else
+            {
+                expected = system_common_length( byte);
+                if (byte == 0xf6) handler.system_common_event( byte, 0, 0);
+            }
+        }
+
+        void append_sysex( unsigned char byte)
+        {
+            if (sysex_size == sysex_buffer.size())
+            {
+                flush_sysex();
+                sysex_status = 0xf7;
+            }
+            sysex_buffer[sysex_size++] = byte;
+        }
+
+        void flush_sysex()
+        {
+            events::sysex event;
+            event.status = sysex_status;
+            event.size = static_cast<unsigned>( sysex_size);
+            handler.sysex_event( event, &sysex_buffer[0]);
+            sysex_size = 0;
+        }
+
+        Handler                     &handler;
+        unsigned char               status;     ///< the status of the message being received, or the running status.
+        unsigned                    expected;   ///< the number of data bytes of that message, zero to drop data bytes.
+        unsigned                    received;   ///< the number of data bytes of that message received so far.
+        unsigned char               data[2];
+        bool                        in_sysex;
+        unsigned char               sysex_status;
+        size_t                      sysex_size;
+        std::vector<unsigned char>  sysex_buffer;
+        size_t                      dropped;
+    };
+}
+
+#endif //WIRE_DECODER_HPP
@@ -0,0 +1,180 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <thread>
+#include <atomic>
+#include <algorithm> // for min
+#include "include/midi_decoder.hpp"
+
+namespace decoding
+{
+    namespace
+    {
+        /// add 'offset' to the payload offset of all sysex events in a track.
+        void relocate_sysex_events( midi_track &track, unsigned offset)
+        {
+            for (midi_track::iterator i = track.begin(); i != track.end(); ++i)
+            {
+                if (events::sysex *event = boost::get<events::sysex>( &i->event))
+                {
+                    event->offset += offset;
+                }
+            }
+        }
+
+        /// add 'amount' to memory_used, unless that would take it over 'limit'.
+        /// Other threads may claim memory at the same time, so the check and the addition are a single step. A track
+        /// that doesn't fit leaves memory_used untouched, and so doesn't count against the tracks that follow.
+        bool claim_memory( std::atomic<size_t> &memory_used, size_t amount, size_t limit)
+        {
+            size_t used = memory_used.load();
+            do
+            {
+                if (amount > limit || used > limit - amount) return false;
+            }
+            while (!memory_used.compare_exchange_weak( used, used + amount));
+            return true;
+        }
+    }
+
+    /// Without filtering, the track is reserved up front. A filtered track may end up holding only a small part of
+    /// the events, so it is left to grow as needed.
+    bool decode_track_chunk(
+        const track_chunk &chunk, int &running_status, midi_track &track, midi_file::sysex_data_type *sysex_data,
+        const event_filter &filter, const decode_limits &limits, std::atomic<size_t> &memory_used)
+    {
+        size_t expected_events = estimate_event_count( chunk.end - chunk.begin);
+        if (!limits.unlimited())
+        {
+            track_measurer measurer( sysex_data != 0);
+            int measured_status = running_status;
+            if (   !decode_track_events( chunk.begin, chunk.end, measured_status, measurer, limits)
+                || measurer.events > limits.max_events_per_track
+                || !claim_memory( memory_used, measurer.memory(), limits.max_file_memory))
+            {
+                return false;
+            }
+            expected_events = measurer.events;
+        }
+
+        if (!filter.accepts_all())
+        {
+            filtering_track_builder builder( track, sysex_data, filter);
+            return decode_track_events( chunk.begin, chunk.end, running_status, builder) && !builder.overflowed();
+        }
+        else
+        {
+            track.reserve( expected_events);
+            track_builder builder( track, sysex_data);
+            return decode_track_events( chunk.begin, chunk.end, running_status, builder);
+        }
+    }
+
+    /// Decode a complete midi file: a header chunk followed by zero or more track chunks.
+    /// Just like the spirit grammar, the running status is kept across track boundaries.
+    bool decode_midifile( const unsigned char *data, size_t size, midi_file &result, bool capture_sysex, const event_filter &filter, const decode_limits &limits)
+    {
+        result.tracks.clear();
+        result.sysex_data.clear();
+
+        byte_iterator first = data;
+        byte_iterator last = data + size;
+
+        // an empty input is accepted as an empty file, just like the grammar does.
+        if (first == last) return true;
+
+        if (!read_header( first, last, result.header)) return false;
+
+        // don't trust the header further than the input: every track chunk takes at least eight bytes.
+        result.tracks.reserve( std::min<size_t>( result.header.number_of_tracks, (last - first) / 8));
+
+        std::atomic<size_t> memory_used( 0);
+        int running_status = -1;
+        while (first != last)
+        {
+            unsigned chunk_size = 0;
+            if (!read_chunk_header( first, last, "MTrk", chunk_size) || size_t( last - first) < chunk_size) return false;
+
+            const track_chunk chunk = { first, first + chunk_size};
+            result.tracks.push_back( midi_track());
+            if (!decode_track_chunk( chunk, running_status, result.tracks.back(), capture_sysex ? &result.sysex_data : 0, filter, limits, memory_used))
+            {
+                result.tracks.pop_back();
+                return false;
+            }
+            first += chunk_size;
+        }
+
+        return true;
+    }
+
+    /// Decode the track chunks found in a first pass concurrently.
+    /// Threads pick the next undecoded track from a shared counter, so that a few large tracks don't keep the other
+    /// threads waiting.
+    bool decode_midifile_parallel( const unsigned char *data, size_t size, midi_file &result, unsigned threads, bool capture_sysex, const event_filter &filter, const decode_limits &limits)
+    {
+        result.tracks.clear();
+        result.sysex_data.clear();
+
+        byte_iterator first = data;
+        byte_iterator last = data + size;
+        if (first == last) return true;
+
+        std::vector<track_chunk> chunks;
+        if (!read_header( first, last, result.header) || !find_track_chunks( first, last, chunks)) return false;
+
+        result.tracks.resize( chunks.size());
+
+        // every track gets its own sysex arena while decoding, these are joined afterwards.
+        std::vector<midi_file::sysex_data_type> track_sysex_data( capture_sysex ? chunks.size() : 0);
+
+        std::atomic<size_t> next_track( 0);
+        std::atomic<size_t> memory_used( 0);
+        std::atomic<bool>   failed( false);
+        auto worker = [&]()
+            {
+                for (size_t track = next_track++; track < chunks.size() && !failed; track = next_track++)
+                {
+                    int running_status = -1;
+                    midi_file::sysex_data_type *sysex_data = capture_sysex ? &track_sysex_data[track] : 0;
+                    if (!decode_track_chunk( chunks[track], running_status, result.tracks[track], sysex_data, filter, limits, memory_used))
+                    {
+                        failed = true;
+                    }
+                }
+            };
+
+        if (threads == 0) threads = std::max( 1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>( std::min<size_t>( threads, chunks.size()));
+
+        // this thread is one of the workers too.
+        std::vector<std::thread> pool;
+        for (unsigned thread = 1; thread < threads; ++thread)
+        {
+            pool.push_back( std::thread( worker));
+        }
+        worker();
+        for (std::vector<std::thread>::iterator i = pool.begin(); i != pool.end(); ++i)
+        {
+            i->join();
+        }
+
+        if (failed) return false;
+
+        for (size_t track = 0; track != track_sysex_data.size(); ++track)
+        {
+            if (!track_sysex_data[track].empty())
+            {
+                relocate_sysex_events( result.tracks[track], static_cast<unsigned>( result.sysex_data.size()));
+                result.sysex_data.insert( result.sysex_data.end(), track_sysex_data[track].begin(), track_sysex_data[track].end());
+            }
+        }
+
+        return true;
+    }
+}
@@ -23,7 +23,14 @@ BOOST_FUSION_ADAPT_STRUCT(
 BOOST_FUSION_ADAPT_STRUCT(
     events::meta,
     (unsigned char, type)
-    (std::vector<unsigned char>, bytes)
+    (events::meta::bytes_type, bytes)
+    )
+
+BOOST_FUSION_ADAPT_STRUCT(
+    events::sysex,
+    (unsigned char, status)
+    (unsigned, offset)
+    (unsigned, size)
     )
 
 BOOST_FUSION_ADAPT_STRUCT(
@@ -24,7 +24,7 @@ BOOST_FUSION_ADAPT_STRUCT(
 BOOST_FUSION_ADAPT_STRUCT(
     midi_file,
     (midi_header, header)
-    (std::vector<midi_track>, tracks)
+    (midi_file::tracks_type, tracks)
 )
 
 
@@ -0,0 +1,201 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <algorithm>
+#include <cstring>
+#include "include/midi_index.hpp"
+
+namespace
+{
+    typedef midi_index::tick_type tick_type;
+
+    const unsigned char tempo_meta_type = 81;
+
+    /// Visitor that applies channel events to a playback state.
+    struct state_updater : boost::static_visitor<>
+    {
+        explicit state_updater( playback_state &state)
+            : state( state)
+        {
+        }
+
+        void operator()( const events::channel_event &event) const
+        {
+            channel = &state.channels[event.channel & 0x0f];
+            boost::apply_visitor( *this, event.event);
+        }
+
+        void operator()( const events::meta &event) const
+        {
+            if (event.type == tempo_meta_type && event.bytes.size() == 3)
+            {
+                state.tempo = (event.bytes[0] << 16) + (event.bytes[1] << 8) + event.bytes[2];
+            }
+        }
+
+        void operator()( const events::controller &event) const
+        {
+            channel->controllers[event.which & 0x7f] = event.value;
+        }
+
+        void operator()( const events::program_change &event) const
+        {
+            channel->program = event.program;
+        }
+
+        void operator()( const events::pitch_bend &event) const
+        {
+            channel->pitch_bend = event.value;
+        }
+
+        /// all other events do not change the state.
+        template<typename Event>
+        void operator()( const Event &) const
+        {
+        }
+
+        playback_state &state;
+        mutable channel_state *channel;
+    };
+
+    /// An event that must be replayed to get from a snapshot to a later playback state.
+    struct replayed_event
+    {
+        tick_type   tick;
+        size_t      track;
+        size_t      event;
+
+        bool operator<( const replayed_event &other) const
+        {
+            return tick < other.tick
+                || (tick == other.tick && (track < other.track || (track == other.track && event < other.event)));
+        }
+    };
+}
+
+channel_state::channel_state()
+    : program( not_set), pitch_bend( pitch_bend_not_set)
+{
+    std::memset( controllers, not_set, sizeof controllers);
+}
+
+playback_state::playback_state()
+    : tick( 0), tempo( tempo_map::default_tempo)
+{
+}
+
+void playback_state::apply( const events::midi_event &event)
+{
+    boost::apply_visitor( state_updater( *this), event);
+}
+
+/// Visitor that is offered all events of a file in chronological order and records snapshots.
+struct midi_index::index_builder
+{
+    explicit index_builder( midi_index &index)
+        : index( index), next_snapshot( index.interval)
+    {
+    }
+
+    void operator()( const events::timed_midi_event_ref &event)
+    {
+        while (next_snapshot <= event.absolute_time)
+        {
+            state.tick = next_snapshot;
+            index.state_snapshots.push_back( state);
+            next_snapshot += index.interval;
+        }
+        state.apply( event.event.event);
+    }
+
+    midi_index      &index;
+    playback_state  state;
+    tick_type       next_snapshot;
+};
+
+midi_index::midi_index( const midi_file &file, tick_type snapshot_interval)
+    : indexed_file( &file), interval( snapshot_interval), last_tick( 0), file_tempo_map( file)
+{
+    if (!interval)
+    {
+        interval = file_tempo_map.is_smpte() ? file_tempo_map.seconds_to_ticks( 4.0) : 16 * file.header.division;
+        interval = std::max<tick_type>( interval, 1);
+    }
+
+    track_ticks.resize( file.tracks.size());
+    for (size_t track = 0; track < file.tracks.size(); ++track)
+    {
+        const midi_track &events = file.tracks[track];
+        tick_table &ticks = track_ticks[track];
+        ticks.reserve( events.size());
+
+        tick_type time = 0;
+        for (midi_track::const_iterator i = events.begin(); i != events.end(); ++i)
+        {
+            time += i->delta_time;
+            ticks.push_back( time);
+        }
+        last_tick = std::max( last_tick, time);
+    }
+
+    state_snapshots.push_back( playback_state());
+
+    midi_multiplexer multiplexer( file.tracks);
+    multiplexer.accept( index_builder( *this));
+}
+
+size_t midi_index::position( size_t track, tick_type tick) const
+{
+    const tick_table &ticks = track_ticks[track];
+    return std::lower_bound( ticks.begin(), ticks.end(), tick) - ticks.begin();
+}
+
+void midi_index::positions( tick_type tick, positions_type &result) const
+{
+    result.resize( track_ticks.size());
+    for (size_t track = 0; track < track_ticks.size(); ++track)
+    {
+        const size_t event = position( track, tick);
+        result[track].event = event;
+        result[track].time = event < track_ticks[track].size() ? track_ticks[track][event] : tick;
+    }
+}
+
+playback_state midi_index::state_at( tick_type tick) const
+{
+    const size_t snapshot = static_cast<size_t>( std::min<tick_type>( tick / interval, state_snapshots.size() - 1));
+    playback_state result = state_snapshots[snapshot];
+
+    // collect the events between the snapshot and the requested time in the order in which the multiplexer would
+    // offer them and apply them to the snapshot.
+    std::vector<replayed_event> replay;
+    for (size_t track = 0; track < track_ticks.size(); ++track)
+    {
+        const size_t end = position( track, tick);
+        for (size_t event = position( track, result.tick); event < end; ++event)
+        {
+            replayed_event e = { track_ticks[track][event], track, event};
+            replay.push_back( e);
+        }
+    }
+    std::sort( replay.begin(), replay.end());
+
+    for (std::vector<replayed_event>::const_iterator i = replay.begin(); i != replay.end(); ++i)
+    {
+        result.apply( indexed_file->tracks[i->track][i->event].event);
+    }
+    result.tick = tick;
+    return result;
+}
+
+midi_multiplexer midi_index::seek( tick_type tick) const
+{
+    positions_type start;
+    positions( tick, start);
+    return midi_multiplexer( indexed_file->tracks, start, tick);
+}
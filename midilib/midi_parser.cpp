@@ -8,7 +8,10 @@
 
 #include <vector>
 #include <iostream>
+#include <fstream>
 #include <iterator>
+#include <string>
+#include <stdexcept>
 
 #include <boost/config/warning_disable.hpp>
 
@@ -17,8 +20,11 @@
 #include <boost/spirit/include/phoenix_fusion.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/qi_binary.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include "include/midi_parser.hpp"
+#include "include/midi_decoder.hpp"
+#include "include/midi_validator.hpp"
 #include "next_directive.hpp"
 #include "midi_events_fusion.hpp"
 #include "midi_file_fusion.hpp"
@@ -36,7 +42,7 @@ struct midi_parser: grammar< Iterator, midi_file()>
         midi_parser::base_type( file),
             running_status(-1)
     {
-        using boost::spirit::ascii::char_;
+        using boost::spirit::standard::char_;
         using boost::phoenix::ref;
         using boost::phoenix::at_c;
         using boost::spirit::qi::rule;
@@ -75,8 +81,9 @@ struct midi_parser: grammar< Iterator, midi_file()>
             ;
 
         // a sysex event starts with 0xF7 or 0xF0, followed by a size, followed by the indicated amount of bytes.
+        // Only the status byte is stored, this grammar doesn't capture the sysex payload.
         sysex_event
-            = (char_('\xf0') | char_('\xf7')) >> variable_length_quantity[ _a = _1] >> repeat(_a)[byte_]
+            = (char_('\xf0') | char_('\xf7'))[ at_c<0>(_val) = _1] >> variable_length_quantity[ _a = _1] >> repeat(_a)[byte_]
             ;
 
         // a variable length quantity consist of zero or more bytes with the high bit set, followed by a single byte with a zero most significant bit.
@@ -172,29 +179,115 @@ struct midi_parser: grammar< Iterator, midi_file()>
     rule<Iterator, events::channel_event(), locals<unsigned int>     > channel_event;
 };
 
-/// parse the midi file that the istream 'in' refers to and return the result in a midi_file structure
-/// Note that on some platforms the input file must have been opened as binary.
-bool parse_midifile( std::istream &in, midi_file &result)
+namespace
 {
+    /// run the midi grammar over the byte range [first, last) and store the result in 'result'.
+    /// Returns true iff the complete range could be parsed as a midi file.
+    template<typename Iterator>
+    bool parse_range( Iterator first, Iterator last, midi_file &result)
+    {
+        result.tracks.clear();
+        result.sysex_data.clear();
 
-    result.tracks.clear();
+        midi_parser<Iterator> parser;
+        boost::spirit::qi::parse( first, last, parser, result);
 
-    // don't skip whitespaces.
-    in.unsetf( std::ios_base::skipws);
+        return first == last;
+    }
+}
 
-    // copy the whole file into a string.
-    typedef std::istreambuf_iterator<char> base_iterator;
+/// parse the midi file that the istream 'in' refers to and return the result in a midi_file structure
+/// Note that on some platforms the input file must have been opened as binary.
+/// This overload has to copy the complete stream into memory before parsing. For regular files, the
+/// overload that takes a file name is cheaper, because it maps the file into memory instead.
+/// Reading stops as soon as the stream turns out to be larger than the maximum file size of the limits.
+bool parse_midifile( std::istream &in, midi_file &result, const parse_options &options)
+{
+    // copy the whole file into a buffer, one block at a time. Never read more than one byte beyond the maximum size,
+    // which is enough to know that the file is too large.
     typedef std::vector<unsigned char> buffer_type;
-    typedef buffer_type::iterator iterator;
     buffer_type buffer;
-    buffer.assign( base_iterator(in), base_iterator());
+    std::streambuf *source = in.rdbuf();
+    if (source)
+    {
+        const size_t max_size = options.limits.max_file_size;
+        const size_t block_size = 64 * 1024;
+        size_t requested = 0;
+        std::streamsize read = 0;
+        do
+        {
+            const buffer_type::size_type old_size = buffer.size();
+            const size_t remaining = max_size - old_size;
+            requested = remaining < block_size ? remaining + 1 : block_size;
+            buffer.resize( old_size + requested);
+            read = source->sgetn( reinterpret_cast<char *>( &buffer[old_size]), static_cast<std::streamsize>( requested));
+            buffer.resize( old_size + static_cast<buffer_type::size_type>( read));
+        } while (size_t( read) == requested && buffer.size() <= max_size);
+
+        if (buffer.size() > max_size) return false;
+    }
 
-    // parse the string
-    midi_parser<iterator> parser;
-    iterator first = buffer.begin();
-    iterator last = buffer.end();
+    const unsigned char *data = buffer.empty() ? 0 : &buffer[0];
+    return parse_midifile( data, buffer.size(), result, options);
+}
 
-    boost::spirit::qi::parse( first, last, parser, result);
+/// parse the midi file that is stored in the memory range [data, data + size).
+/// The parser runs directly over the given bytes, no copy is made.
+bool parse_midifile( const unsigned char *data, size_t size, midi_file &result, const parse_options &options)
+{
+    if (size > options.limits.max_file_size)
+    {
+        result.tracks.clear();
+        result.sysex_data.clear();
+        return false;
+    }
+    else if (options.skip_corrupt_tracks)
+    {
+        midi_validation validation = validate_midifile( data, size);
+        return recover_midifile( data, size, validation, result, options);
+    }
+    else if (options.threads != 1)
+    {
+        return decoding::decode_midifile_parallel( data, size, result, options.threads, options.capture_sysex, options.filter, options.limits);
+    }
+    else if (   options.backend == parse_options::table_backend
+             || options.capture_sysex
+             || !options.filter.accepts_all()
+             || !options.limits.unlimited())
+    {
+        return decoding::decode_midifile( data, size, result, options.capture_sysex, options.filter, options.limits);
+    }
+    else
+    {
+        return parse_range( data, data + size, result);
+    }
+}
+
+/// parse the midi file with the given file name.
+/// The file is mapped read-only into memory and parsed in-place. Files that can't be mapped (pipes,
+/// character devices, empty files) are read through a stream instead.
+bool parse_midifile( const std::string &filename, midi_file &result, const parse_options &options)
+{
+    using boost::iostreams::mapped_file_source;
+
+    mapped_file_source file;
+    try
+    {
+        file.open( filename);
+    }
+    catch (const std::exception &)
+    {
+    }
+
+    if (!file.is_open())
+    {
+        std::ifstream stream( filename.c_str(), std::ios::binary);
+        if (!stream)
+        {
+            throw std::runtime_error( "could not open " + filename + " for reading");
+        }
+        return parse_midifile( stream, result, options);
+    }
 
-    return first == last;
+    return parse_midifile( reinterpret_cast<const unsigned char *>( file.data()), file.size(), result, options);
 }
@@ -0,0 +1,165 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <ostream>
+#include <iomanip>
+#include <thread>
+#include <algorithm> // for max
+#include "include/midi_player.hpp"
+#include "include/midi_multiplexer.hpp"
+#include "include/midi_decoder.hpp"
+#include "include/tempo_map.hpp"
+
+namespace
+{
+    typedef boost::uint64_t time_type;
+
+    /// Visitor that writes the bytes of an event, or a short description for meta events.
+    struct event_printer : boost::static_visitor<>
+    {
+        explicit event_printer( std::ostream &output)
+            : output( output)
+        {
+        }
+
+        void operator()( const events::channel_event &event) const
+        {
+            unsigned char status, data1, data2;
+            decoding::split_channel_event( event, status, data1, data2);
+            output << std::hex << std::setfill( '0')
+                << std::setw( 2) << unsigned( status) << ' '
+                << std::setw( 2) << unsigned( data1);
+            if (decoding::channel_event_length[ status >> 4] == 2)
+            {
+                output << ' ' << std::setw( 2) << unsigned( data2);
+            }
+            output << std::dec << std::setfill( ' ');
+        }
+
+        void operator()( const events::meta &event) const
+        {
+            output << "meta " << unsigned( event.type) << ' ' << event.bytes.size();
+        }
+
+        void operator()( const events::sysex &event) const
+        {
+            output << "sysex " << std::hex << unsigned( event.status) << std::dec << ' ' << event.size;
+        }
+
+        std::ostream &output;
+    };
+
+    /// Visitor that collects the events of a file with their absolute times.
+    struct scheduler
+    {
+        scheduler( std::vector<scheduled_event> &events, const tempo_map &tempo, time_type start_tick)
+            : events( events), tempo( tempo), start_tick( start_tick), start_time( tempo.ticks_to_microseconds( start_tick))
+        {
+        }
+
+        void operator()( const events::timed_midi_event_ref &event)
+        {
+            if (event.absolute_time >= start_tick)
+            {
+                scheduled_event scheduled;
+                scheduled.due = tempo.ticks_to_microseconds( event.absolute_time) - start_time;
+                scheduled.tick = event.absolute_time;
+                scheduled.event = &event.event;
+                events.push_back( scheduled);
+            }
+        }
+
+        std::vector<scheduled_event>    &events;
+        const tempo_map                 &tempo;
+        const time_type                 start_tick;
+        const time_type                 start_time;
+    };
+}
+
+void stream_sink::send( const scheduled_event *first, size_t count, boost::uint64_t now)
+{
+    for (const scheduled_event *event = first; event != first + count; ++event)
+    {
+        output << event->due << '\t' << now << '\t' << event->tick << '\t';
+        boost::apply_visitor( event_printer( output), event->event->event);
+        output << '\n';
+    }
+    output.flush();
+}
+
+midi_player::midi_player( const midi_file &file, const player_options &options)
+    : options( options), stopped( false)
+{
+    const tempo_map tempo( file);
+    midi_multiplexer multiplexer( file.tracks);
+    multiplexer.accept( scheduler( events, tempo, options.start_tick));
+}
+
+boost::uint64_t midi_player::wait_until( clock_type::time_point start, boost::uint64_t target) const
+{
+    using std::chrono::microseconds;
+
+    const clock_type::time_point deadline = start + microseconds( target);
+    if (options.spin < target)
+    {
+        std::this_thread::sleep_until( deadline - microseconds( options.spin));
+    }
+
+    clock_type::time_point now = clock_type::now();
+    while (now < deadline)
+    {
+        now = clock_type::now();
+    }
+    return std::chrono::duration_cast<microseconds>( now - start).count();
+}
+
+/// The player wakes up when the next event is due within the lookahead window, but never more than once per window.
+/// At every wakeup, all events that are due before the end of the window are sent to the sink in one batch.
+playback_statistics midi_player::play( playback_sink &sink)
+{
+    playback_statistics statistics;
+    stopped = false;
+    if (events.empty()) return statistics;
+
+    const time_type lookahead = options.lookahead;
+    const clock_type::time_point start = clock_type::now();
+    size_t next = 0;
+    time_type wakeup = events[0].due > lookahead ? events[0].due - lookahead : 0;
+
+    while (next < events.size() && !stopped)
+    {
+        const time_type now = wait_until( start, wakeup);
+        const time_type jitter = now - wakeup;
+        statistics.total_jitter += jitter;
+        statistics.max_jitter = std::max( statistics.max_jitter, jitter);
+
+        size_t end = next;
+        while (end < events.size() && events[end].due <= now + lookahead)
+        {
+            if (events[end].due < now)
+            {
+                ++statistics.late_events;
+                statistics.max_lateness = std::max( statistics.max_lateness, now - events[end].due);
+            }
+            ++end;
+        }
+
+        sink.send( &events[next], end - next, now);
+        statistics.events += end - next;
+        ++statistics.batches;
+        next = end;
+
+        if (next < events.size())
+        {
+            // the next event is due after now + lookahead, so the next wakeup is always in the future.
+            wakeup = std::max( wakeup + lookahead, events[next].due - lookahead);
+        }
+    }
+
+    return statistics;
+}
@@ -0,0 +1,341 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include <boost/filesystem/operations.hpp>
+#include "include/midi_snapshot.hpp"
+#include "include/midi_parser.hpp"
+#include "include/midi_decoder.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    using snapshot_format::file_header;
+    using snapshot_format::track_entry;
+    using snapshot_format::record;
+
+    typedef std::vector<unsigned char> payload_type;
+
+    /// Visitor that fills the status, data and payload fields of a record from an event.
+    struct record_builder : boost::static_visitor<>
+    {
+        record_builder( const midi_file &file, record &result, payload_type &payload)
+            : file( file), result( result), payload( payload)
+        {
+        }
+
+        void operator()( const events::channel_event &event) const
+        {
+            decoding::split_channel_event( event, result.status, result.data1, result.data2);
+        }
+
+        void operator()( const events::meta &event) const
+        {
+            result.status = 0xff;
+            result.data1 = event.type;
+            append( event.bytes.empty() ? 0 : &event.bytes[0], event.bytes.size());
+        }
+
+        void operator()( const events::sysex &event) const
+        {
+            result.status = event.status;
+            append( file.sysex_bytes( event), file.sysex_data.empty() ? 0 : event.size);
+        }
+
+        void append( const unsigned char *bytes, size_t size) const
+        {
+            result.payload_offset = static_cast<boost::uint32_t>( payload.size());
+            result.payload_size = static_cast<boost::uint32_t>( size);
+            payload.insert( payload.end(), bytes, bytes + size);
+        }
+
+        const midi_file &file;
+        record          &result;
+        payload_type    &payload;
+    };
+
+    template<typename T>
+    void write_items( std::ostream &out, const std::vector<T> &items)
+    {
+        if (!items.empty())
+        {
+            out.write( reinterpret_cast<const char *>( &items[0]), items.size() * sizeof( T));
+        }
+    }
+
+    /// 64-bit FNV-1a hash, used to derive a file name from a path. Unlike std::hash, the result does not depend on the
+    /// standard library, so that a cache directory can be shared between builds.
+    boost::uint64_t fnv1a( const std::string &text)
+    {
+        boost::uint64_t hash = 14695981039346656037ull;
+        for (std::string::const_iterator i = text.begin(); i != text.end(); ++i)
+        {
+            hash ^= static_cast<unsigned char>( *i);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    struct time_before
+    {
+        bool operator()( const record &r, boost::uint64_t time) const
+        {
+            return r.absolute_time < time;
+        }
+    };
+}
+
+size_t snapshot_track::position( boost::uint64_t time) const
+{
+    return std::lower_bound( first, last, time, time_before()) - first;
+}
+
+void snapshot_track::unpack( const record &r, events::timed_midi_event &result) const
+{
+    result.delta_time = r.delta_time;
+
+    // a valid snapshot only holds valid records, but a damaged or stale file may not. Invalid payload ranges are treated
+    // as empty and invalid status bytes as an empty sysex packet, so that no event is ever built from garbage.
+    const bool valid_payload = r.payload_offset <= payload_size && r.payload_size <= payload_size - r.payload_offset;
+    if (r.status == 0xff)
+    {
+        result.event = events::meta();
+        events::meta &meta = boost::get<events::meta>( result.event);
+        meta.type = r.data1;
+        if (valid_payload)
+        {
+            meta.bytes.assign( payload + r.payload_offset, payload + r.payload_offset + r.payload_size);
+        }
+    }
+    else if (r.status >= 0x80 && r.status < 0xf0)
+    {
+        events::channel_event event;
+        decoding::make_channel_event( r.status, r.data1, r.data2, event);
+        result.event = event;
+    }
+    else
+    {
+        events::sysex sysex;
+        sysex.status = 0xf7;
+        if ((r.status == 0xf0 || r.status == 0xf7) && valid_payload)
+        {
+            sysex.status = r.status;
+            sysex.offset = r.payload_offset;
+            sysex.size = r.payload_size;
+        }
+        result.event = sysex;
+    }
+}
+
+bool midi_snapshot::open( const std::string &filename)
+{
+    close();
+    try
+    {
+        mapping.open( filename);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+
+    if (!mapping.is_open() || !attach( reinterpret_cast<const unsigned char *>( mapping.data()), mapping.size()))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/// check the header and the section sizes against the size of the data and create a view for every track.
+/// Individual records are not inspected, so attaching takes time proportional to the number of tracks only.
+bool midi_snapshot::attach( const unsigned char *data, size_t size)
+{
+    snapshot_tracks.clear();
+    payload = 0;
+
+    file_header header;
+    if (!data || size < sizeof header) return false;
+    std::memcpy( &header, data, sizeof header);
+    if (   std::memcmp( header.magic, snapshot_format::magic, sizeof header.magic) != 0
+        || header.version != snapshot_format::version
+        || header.byte_order != snapshot_format::byte_order_mark)
+    {
+        return false;
+    }
+
+    // determine the section offsets, taking care that none of the computations can overflow.
+    size_t remaining = size - sizeof header;
+    if (header.track_count > remaining / sizeof( track_entry)) return false;
+    remaining -= header.track_count * sizeof( track_entry);
+    if (header.record_count > remaining / sizeof( record)) return false;
+    remaining -= static_cast<size_t>( header.record_count) * sizeof( record);
+    if (header.payload_size > remaining) return false;
+    remaining -= static_cast<size_t>( header.payload_size);
+    if (header.source_path_size > remaining) return false;
+
+    const track_entry *entries = reinterpret_cast<const track_entry *>( data + sizeof header);
+    const record *records = reinterpret_cast<const record *>( entries + header.track_count);
+    payload = reinterpret_cast<const unsigned char *>( records + header.record_count);
+    const char *source_path = reinterpret_cast<const char *>( payload + header.payload_size);
+
+    snapshot_tracks.reserve( header.track_count);
+    for (const track_entry *entry = entries; entry != entries + header.track_count; ++entry)
+    {
+        if (entry->first_record > header.record_count || entry->record_count > header.record_count - entry->first_record)
+        {
+            snapshot_tracks.clear();
+            payload = 0;
+            return false;
+        }
+        const record *first = records + entry->first_record;
+        snapshot_tracks.push_back( snapshot_track( first, first + entry->record_count, payload, static_cast<size_t>( header.payload_size)));
+    }
+
+    snapshot_header.format = header.format;
+    snapshot_header.number_of_tracks = header.number_of_tracks;
+    snapshot_header.division = header.division;
+    source_info.path.assign( source_path, header.source_path_size);
+    source_info.size = header.source_size;
+    source_info.mtime = header.source_mtime;
+    return true;
+}
+
+void midi_snapshot::close()
+{
+    snapshot_tracks.clear();
+    payload = 0;
+    source_info = snapshot_source();
+    if (mapping.is_open())
+    {
+        mapping.close();
+    }
+}
+
+bool write_snapshot( const midi_file &file, std::ostream &out, const snapshot_source &source)
+{
+    std::vector<track_entry> entries;
+    std::vector<record> records;
+    payload_type payload;
+
+    entries.reserve( file.tracks.size());
+    for (midi_file::tracks_type::const_iterator track = file.tracks.begin(); track != file.tracks.end(); ++track)
+    {
+        track_entry entry;
+        entry.first_record = records.size();
+        entry.record_count = track->size();
+        entries.push_back( entry);
+
+        boost::uint64_t time = 0;
+        for (midi_track::const_iterator event = track->begin(); event != track->end(); ++event)
+        {
+            record r = record();
+            time += event->delta_time;
+            r.absolute_time = time;
+            r.delta_time = event->delta_time;
+            boost::apply_visitor( record_builder( file, r, payload), event->event);
+            records.push_back( r);
+        }
+    }
+
+    file_header header = file_header();
+    std::memcpy( header.magic, snapshot_format::magic, sizeof header.magic);
+    header.version = snapshot_format::version;
+    header.byte_order = snapshot_format::byte_order_mark;
+    header.format = file.header.format;
+    header.number_of_tracks = file.header.number_of_tracks;
+    header.division = file.header.division;
+    header.track_count = static_cast<boost::uint32_t>( entries.size());
+    header.record_count = records.size();
+    header.payload_size = payload.size();
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.source_path_size = static_cast<boost::uint32_t>( source.path.size());
+
+    out.write( reinterpret_cast<const char *>( &header), sizeof header);
+    write_items( out, entries);
+    write_items( out, records);
+    write_items( out, payload);
+    out.write( source.path.data(), source.path.size());
+    return !!out;
+}
+
+bool write_snapshot( const midi_file &file, const std::string &filename, const snapshot_source &source)
+{
+    std::ofstream out( filename.c_str(), std::ios::binary);
+    return out && write_snapshot( file, out, source) && out.flush();
+}
+
+snapshot_cache::snapshot_cache( const std::string &directory, const decode_limits &limits)
+    : directory( directory), limits( limits)
+{
+    fs::create_directories( this->directory);
+}
+
+std::string snapshot_cache::snapshot_path( const std::string &path) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw( 16) << std::setfill( '0') << fnv1a( fs::absolute( path).string()) << ".midisnap";
+    return (directory / name.str()).string();
+}
+
+bool snapshot_cache::open( const std::string &path, midi_snapshot &result) const
+{
+    snapshot_source source;
+    source.path = fs::absolute( path).string();
+
+    // boost::filesystem reports the modification time in seconds, the standard library with the resolution of the
+    // file system. A file that is rewritten within a second must not get the snapshot of its previous contents.
+    boost::system::error_code error;
+    std::error_code time_error;
+    source.size = fs::file_size( source.path, error);
+    const std::filesystem::file_time_type mtime = std::filesystem::last_write_time( source.path, time_error);
+    source.mtime = mtime.time_since_epoch().count();
+    if (error || time_error)
+    {
+        throw std::runtime_error( "could not open " + path + " for reading");
+    }
+
+    const std::string snapshot = snapshot_path( path);
+    if (   result.open( snapshot)
+        && result.source().path == source.path
+        && result.source().size == source.size
+        && result.source().mtime == source.mtime)
+    {
+        return true;
+    }
+    result.close();
+
+    midi_file file;
+    parse_options options( parse_options::table_backend);
+    options.capture_sysex = true;
+    options.limits = limits;
+    if (!parse_midifile( source.path, file, options)) return false;
+
+    // write to a temporary file first, so that other processes never map a partially written snapshot.
+    const fs::path temporary = directory / fs::unique_path( "%%%%-%%%%-%%%%-%%%%.tmp");
+    if (!write_snapshot( file, temporary.string(), source))
+    {
+        fs::remove( temporary, error);
+        throw std::runtime_error( "could not write snapshot " + temporary.string());
+    }
+    fs::rename( temporary, snapshot);
+
+    if (!result.open( snapshot))
+    {
+        throw std::runtime_error( "could not map snapshot " + snapshot);
+    }
+    return true;
+}
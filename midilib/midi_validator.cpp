@@ -0,0 +1,196 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cstring> // for memcmp
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "include/midi_validator.hpp"
+#include "include/midi_decoder.hpp"
+#include "include/simd_scan.hpp"
+
+using decoding::byte_iterator;
+
+namespace
+{
+    const size_t chunk_header_size = 8;
+
+    /// whether four bytes could be the signature of a chunk that we don't know. The standard requires readers to skip
+    /// those, but in practice anything that isn't printable is garbage.
+    bool is_chunk_signature( byte_iterator signature)
+    {
+        for (unsigned index = 0; index != 4; ++index)
+        {
+            if (signature[index] < 0x20 || signature[index] > 0x7e) return false;
+        }
+        return true;
+    }
+
+    chunk_validation make_chunk( chunk_validation::status_type status, byte_iterator data, byte_iterator begin, byte_iterator end)
+    {
+        chunk_validation chunk;
+        chunk.status = status;
+        chunk.offset = begin - data;
+        chunk.size = end - begin;
+        chunk.events = 0;
+        return chunk;
+    }
+}
+
+bool midi_validation::valid() const
+{
+    return header_valid && skipped_bytes == 0 && valid_tracks() == chunks.size() && track_count_consistent();
+}
+
+size_t midi_validation::valid_tracks() const
+{
+    size_t count = 0;
+    for (chunks_type::const_iterator chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+    {
+        if (chunk->status == chunk_validation::valid_track) ++count;
+    }
+    return count;
+}
+
+bool midi_validation::track_count_consistent() const
+{
+    if (!header_valid) return false;
+
+    size_t tracks = 0;
+    for (chunks_type::const_iterator chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+    {
+        if (chunk->status != chunk_validation::foreign_chunk) ++tracks;
+    }
+    return header.number_of_tracks == tracks;
+}
+
+midi_validation validate_midifile( const unsigned char *data, size_t size, bool check_events)
+{
+    using namespace decoding;
+
+    midi_validation result;
+    byte_iterator first = data;
+    const byte_iterator last = data + size;
+    if (!read_header( first, last, result.header)) return result;
+    result.header_valid = true;
+
+    int running_status = -1;
+    while (size_t( last - first) >= chunk_header_size)
+    {
+        const byte_iterator chunk_header = first;
+        const bool is_track = std::memcmp( chunk_header, "MTrk", 4) == 0;
+        unsigned chunk_size = 0;
+        byte_iterator chunk_begin = chunk_header + 4;
+        read_big_dword( chunk_begin, last, chunk_size);
+
+        if (!is_track && (!is_chunk_signature( chunk_header) || size_t( last - chunk_begin) < chunk_size))
+        {
+            // this is not a chunk header, skip to the next track signature.
+            first = simd::find_signature( chunk_header + 1, last, "MTrk");
+            result.skipped_bytes += first - chunk_header;
+            running_status = -1;
+        }
+        else if (size_t( last - chunk_begin) < chunk_size)
+        {
+            // a track that is cut off by the end of the input, or whose chunk size is damaged. In the latter case
+            // the next track may still be intact.
+            first = simd::find_signature( chunk_begin, last, "MTrk");
+            result.chunks.push_back( make_chunk( chunk_validation::truncated_track, data, chunk_begin, first));
+            running_status = -1;
+        }
+        else
+        {
+            const byte_iterator chunk_end = chunk_begin + chunk_size;
+            result.chunks.push_back( make_chunk( is_track ? chunk_validation::valid_track : chunk_validation::foreign_chunk, data, chunk_begin, chunk_end));
+            if (is_track && check_events)
+            {
+                track_measurer measurer( false);
+                if (decode_track_events( chunk_begin, chunk_end, running_status, measurer))
+                {
+                    result.chunks.back().events = measurer.events;
+                }
+                else
+                {
+                    result.chunks.back().status = chunk_validation::malformed_track;
+                    running_status = -1;
+                }
+            }
+            first = chunk_end;
+        }
+    }
+    result.skipped_bytes += last - first;
+
+    return result;
+}
+
+/// Files that can't be mapped (pipes, empty files) are read into memory instead.
+midi_validation validate_midifile( const std::string &filename, bool check_events)
+{
+    using boost::iostreams::mapped_file_source;
+
+    mapped_file_source file;
+    try
+    {
+        file.open( filename);
+    }
+    catch (const std::exception &)
+    {
+    }
+
+    if (!file.is_open())
+    {
+        std::ifstream stream( filename.c_str(), std::ios::binary);
+        if (!stream)
+        {
+            throw std::runtime_error( "could not open " + filename + " for reading");
+        }
+        const std::vector<unsigned char> buffer( (std::istreambuf_iterator<char>( stream)), std::istreambuf_iterator<char>());
+        return validate_midifile( buffer.empty() ? 0 : &buffer[0], buffer.size(), check_events);
+    }
+
+    return validate_midifile( reinterpret_cast<const unsigned char *>( file.data()), file.size(), check_events);
+}
+
+bool recover_midifile( const unsigned char *data, size_t size, midi_validation &validation, midi_file &result, const parse_options &options)
+{
+    using namespace decoding;
+
+    result.tracks.clear();
+    result.sysex_data.clear();
+    if (!validation.header_valid) return false;
+
+    result.header = validation.header;
+    result.tracks.reserve( validation.valid_tracks());
+
+    midi_file::sysex_data_type *sysex_data = options.capture_sysex ? &result.sysex_data : 0;
+    std::atomic<size_t> memory_used( 0);
+    int running_status = -1;
+    typedef midi_validation::chunks_type::iterator iterator;
+    for (iterator chunk = validation.chunks.begin(); chunk != validation.chunks.end(); ++chunk)
+    {
+        if (chunk->status != chunk_validation::valid_track || chunk->offset + chunk->size > size)
+        {
+            running_status = -1;
+            continue;
+        }
+
+        const track_chunk track = { data + chunk->offset, data + chunk->offset + chunk->size};
+        const size_t sysex_size = result.sysex_data.size();
+        result.tracks.push_back( midi_track());
+        if (!decode_track_chunk( track, running_status, result.tracks.back(), sysex_data, options.filter, options.limits, memory_used))
+        {
+            result.tracks.pop_back();
+            result.sysex_data.resize( sysex_size);
+            chunk->status = chunk_validation::malformed_track;
+            running_status = -1;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,244 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring> // for memcpy
+#include "include/midi_writer.hpp"
+#include "include/midi_decoder.hpp"
+
+namespace
+{
+    /// Output that only counts bytes, used to size the output buffer and the track chunks.
+    struct byte_counter
+    {
+        byte_counter()
+            : size( 0)
+        {
+        }
+
+        void put( unsigned char)
+        {
+            ++size;
+        }
+
+        void put( const unsigned char *, size_t count)
+        {
+            size += count;
+        }
+
+        size_t size;
+    };
+
+    /// Output that writes to a buffer that is known to be large enough.
+    struct byte_writer
+    {
+        explicit byte_writer( unsigned char *out)
+            : out( out)
+        {
+        }
+
+        void put( unsigned char byte)
+        {
+            *out++ = byte;
+        }
+
+        void put( const unsigned char *bytes, size_t count)
+        {
+            if (count) std::memcpy( out, bytes, count);
+            out += count;
+        }
+
+        unsigned char *out;
+    };
+
+    template<typename Output>
+    void put_variable_length_quantity( Output &out, size_t value)
+    {
+        // collect the 7-bit groups, least significant first, and emit them in reverse.
+        unsigned char groups[10];
+        unsigned count = 0;
+        do
+        {
+            groups[count++] = value & 0x7f;
+            value >>= 7;
+        } while (value);
+
+        while (--count)
+        {
+            out.put( static_cast<unsigned char>( groups[count] | 0x80));
+        }
+        out.put( groups[0]);
+    }
+
+    template<typename Output>
+    void put_big_endian( Output &out, unsigned value, unsigned bytes)
+    {
+        while (bytes--)
+        {
+            out.put( static_cast<unsigned char>( value >> (8 * bytes)));
+        }
+    }
+
+    /// Visitor that encodes the events of a single track.
+    /// The same code is used to count and to write, so that the computed sizes always match the written output.
+    template<typename Output>
+    struct track_encoder : boost::static_visitor<>
+    {
+        track_encoder( Output &out, const midi_file &file, const write_options &options)
+            : out( out), file( file), options( options), running_status( -1)
+        {
+        }
+
+        void operator()( const events::timed_midi_event &event)
+        {
+            put_variable_length_quantity( out, event.delta_time);
+            boost::apply_visitor( *this, event.event);
+        }
+
+        void operator()( const events::channel_event &event)
+        {
+            unsigned char status, data1, data2;
+            decoding::split_channel_event( event, status, data1, data2);
+
+            // data bytes must not have their high bit set, or a reader would take them for a status byte. Values that
+            // don't fit are rejected rather than truncated, which would silently write other notes or values.
+            if (event.channel > 0x0f || data1 > 0x7f || data2 > 0x7f)
+            {
+                throw std::out_of_range( "channel event value out of range for a midi file");
+            }
+
+            if (!options.running_status || status != running_status)
+            {
+                out.put( status);
+                running_status = status;
+            }
+            out.put( data1);
+            if (decoding::channel_event_length[ status >> 4] == 2)
+            {
+                out.put( data2);
+            }
+        }
+
+        void operator()( const events::meta &event)
+        {
+            out.put( 0xff);
+            out.put( event.type);
+            put_variable_length_quantity( out, event.bytes.size());
+            out.put( event.bytes.empty() ? 0 : &event.bytes[0], event.bytes.size());
+            running_status = -1;
+        }
+
+        void operator()( const events::sysex &event)
+        {
+            const size_t size = file.sysex_data.empty() ? 0 : event.size;
+            out.put( event.status);
+            put_variable_length_quantity( out, size);
+            out.put( file.sysex_bytes( event), size);
+            running_status = -1;
+        }
+
+        /// encode all events of a track, or an end-of-track event if the track is empty.
+        void encode( const midi_track &track)
+        {
+            if (track.empty())
+            {
+                static const unsigned char end_of_track[] = { 0x00, 0xff, 0x2f, 0x00};
+                out.put( end_of_track, sizeof end_of_track);
+            }
+            for (midi_track::const_iterator i = track.begin(); i != track.end(); ++i)
+            {
+                (*this)( *i);
+            }
+        }
+
+        Output                  &out;
+        const midi_file         &file;
+        const write_options     &options;
+        int                     running_status;
+    };
+
+    const size_t chunk_header_size = 8;
+    const size_t file_header_size = chunk_header_size + 6;
+
+    /// determine the size of the events of every track, without chunk headers.
+    void track_sizes( const midi_file &file, const write_options &options, std::vector<size_t> &sizes)
+    {
+        sizes.clear();
+        sizes.reserve( file.tracks.size());
+        for (midi_file::tracks_type::const_iterator i = file.tracks.begin(); i != file.tracks.end(); ++i)
+        {
+            byte_counter counter;
+            track_encoder<byte_counter>( counter, file, options).encode( *i);
+            sizes.push_back( counter.size);
+        }
+    }
+}
+
+size_t midifile_size( const midi_file &file, const write_options &options)
+{
+    std::vector<size_t> sizes;
+    track_sizes( file, options, sizes);
+
+    size_t result = file_header_size;
+    for (std::vector<size_t>::const_iterator i = sizes.begin(); i != sizes.end(); ++i)
+    {
+        result += chunk_header_size + *i;
+    }
+    return result;
+}
+
+void write_midifile( const midi_file &file, std::vector<unsigned char> &buffer, const write_options &options)
+{
+    std::vector<size_t> sizes;
+    track_sizes( file, options, sizes);
+
+    size_t total = file_header_size;
+    for (std::vector<size_t>::const_iterator i = sizes.begin(); i != sizes.end(); ++i)
+    {
+        total += chunk_header_size + *i;
+    }
+    buffer.resize( total);
+
+    byte_writer out( &buffer[0]);
+    out.put( reinterpret_cast<const unsigned char *>( "MThd"), 4);
+    put_big_endian( out, 6, 4);
+    put_big_endian( out, file.header.format, 2);
+    put_big_endian( out, static_cast<unsigned>( file.tracks.size()), 2);
+    put_big_endian( out, file.header.division, 2);
+
+    for (size_t track = 0; track != file.tracks.size(); ++track)
+    {
+        out.put( reinterpret_cast<const unsigned char *>( "MTrk"), 4);
+        put_big_endian( out, static_cast<unsigned>( sizes[track]), 4);
+        track_encoder<byte_writer>( out, file, options).encode( file.tracks[track]);
+    }
+}
+
+bool write_midifile( const midi_file &file, std::ostream &stream, const write_options &options)
+{
+    std::vector<unsigned char> buffer;
+    write_midifile( file, buffer, options);
+    stream.write( reinterpret_cast<const char *>( &buffer[0]), buffer.size());
+    return !!stream;
+}
+
+bool write_midifile( const midi_file &file, const std::string &filename, const write_options &options)
+{
+    // encode before opening, so that a file that can't be encoded doesn't leave an empty file behind.
+    std::vector<unsigned char> buffer;
+    write_midifile( file, buffer, options);
+
+    std::ofstream stream( filename.c_str(), std::ios::binary);
+    if (!stream)
+    {
+        throw std::runtime_error( "could not open " + filename + " for writing");
+    }
+    stream.write( reinterpret_cast<const char *>( &buffer[0]), buffer.size());
+    return !!stream.flush();
+}
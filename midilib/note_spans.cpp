@@ -0,0 +1,190 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <algorithm>
+#include "include/note_spans.hpp"
+
+namespace
+{
+    typedef note_span::tick_type tick_type;
+
+    /// notes without duration are indexed as if they last one tick.
+    tick_type effective_end( const note_span &note)
+    {
+        return std::max( note.end, note.start + 1);
+    }
+
+    /// Visitor that pairs the note events of one track. The notes that are still sounding are kept per channel and
+    /// key, as indices into the result, in the order in which they were struck.
+    struct note_pairer : boost::static_visitor<>
+    {
+        note_pairer( note_span_vector &result, std::vector<size_t> (&sounding)[16 * 128], boost::uint32_t track)
+            : result( result), sounding( sounding), track( track), time( 0), channel( 0)
+        {
+        }
+
+        void operator()( const events::channel_event &event)
+        {
+            channel = event.channel & 0x0f;
+            boost::apply_visitor( *this, event.event);
+        }
+
+        void operator()( const events::note_on &event)
+        {
+            if (event.velocity == 0)
+            {
+                note_off( event.number);
+            }
+            else
+            {
+                note_span note;
+                note.start = time;
+                note.end = time;
+                note.track = track;
+                note.channel = channel;
+                note.key = event.number & 0x7f;
+                note.velocity = event.velocity;
+                sounding[channel * 128 + note.key].push_back( result.size());
+                result.push_back( note);
+            }
+        }
+
+        void operator()( const events::note_off &event)
+        {
+            note_off( event.number);
+        }
+
+        /// all other events are ignored.
+        template<typename Event>
+        void operator()( const Event &)
+        {
+        }
+
+        void note_off( unsigned char key)
+        {
+            std::vector<size_t> &notes = sounding[channel * 128 + (key & 0x7f)];
+            if (!notes.empty())
+            {
+                result[notes.front()].end = time;
+                notes.erase( notes.begin());
+            }
+        }
+
+        note_span_vector    &result;
+        std::vector<size_t> (&sounding)[16 * 128];
+        boost::uint32_t     track;
+        tick_type           time;
+        unsigned char       channel;
+    };
+
+    bool starts_earlier( const note_span &lhs, const note_span &rhs)
+    {
+        return lhs.start < rhs.start;
+    }
+}
+
+void extract_note_spans( const midi_file &file, note_span_vector &result)
+{
+    result.clear();
+
+    std::vector<size_t> sounding[16 * 128];
+    std::vector<size_t> unended;
+    tick_type file_end = 0;
+    for (size_t track = 0; track != file.tracks.size(); ++track)
+    {
+        note_pairer pairer( result, sounding, static_cast<boost::uint32_t>( track));
+        const midi_track &events = file.tracks[track];
+        for (midi_track::const_iterator event = events.begin(); event != events.end(); ++event)
+        {
+            pairer.time += event->delta_time;
+            boost::apply_visitor( pairer, event->event);
+        }
+        file_end = std::max( file_end, pairer.time);
+
+        for (size_t key = 0; key != 16 * 128; ++key)
+        {
+            unended.insert( unended.end(), sounding[key].begin(), sounding[key].end());
+            sounding[key].clear();
+        }
+    }
+
+    // the end of the file is only known after the last track.
+    for (std::vector<size_t>::const_iterator note = unended.begin(); note != unended.end(); ++note)
+    {
+        result[*note].end = file_end;
+    }
+
+    // the notes are in track order, a stable sort keeps simultaneous notes in that order.
+    std::stable_sort( result.begin(), result.end(), starts_earlier);
+}
+
+note_span_index::note_span_index( const note_span_vector &notes)
+    : spans( notes)
+{
+    std::vector<boost::uint32_t> all( spans.size());
+    for (size_t note = 0; note != spans.size(); ++note)
+    {
+        all[note] = static_cast<boost::uint32_t>( note);
+    }
+    std::stable_sort( all.begin(), all.end(),
+        [this]( boost::uint32_t lhs, boost::uint32_t rhs) { return spans[lhs].start < spans[rhs].start; });
+
+    by_start.reserve( spans.size());
+    by_end.reserve( spans.size());
+    if (!all.empty()) build( all);
+}
+
+/// 'notes' is ordered by start time. The center of a node is the start of its median note, so every node holds at
+/// least that note and at most half of the notes end up in either subtree.
+boost::uint32_t note_span_index::build( std::vector<boost::uint32_t> &notes)
+{
+    const boost::uint32_t index = static_cast<boost::uint32_t>( nodes.size());
+    nodes.push_back( node());
+    const tick_type center = spans[notes[notes.size() / 2]].start;
+
+    std::vector<boost::uint32_t> left;
+    std::vector<boost::uint32_t> right;
+    const boost::uint32_t begin = static_cast<boost::uint32_t>( by_start.size());
+    for (std::vector<boost::uint32_t>::const_iterator note = notes.begin(); note != notes.end(); ++note)
+    {
+        const note_span &span = spans[*note];
+        if (effective_end( span) <= center)
+        {
+            left.push_back( *note);
+        }
+        else if (span.start > center)
+        {
+            right.push_back( *note);
+        }
+        else
+        {
+            const entry start = { span.start, *note};
+            const entry end = { effective_end( span), *note};
+            by_start.push_back( start);
+            by_end.push_back( end);
+        }
+    }
+    std::stable_sort( by_end.begin() + begin, by_end.end(),
+        []( const entry &lhs, const entry &rhs) { return lhs.time > rhs.time; });
+
+    // free the memory of this level before descending.
+    std::vector<boost::uint32_t>().swap( notes);
+
+    nodes[index].center = center;
+    nodes[index].begin = begin;
+    nodes[index].end = static_cast<boost::uint32_t>( by_start.size());
+    nodes[index].left = left.empty() ? no_node : build( left);
+    nodes[index].right = right.empty() ? no_node : build( right);
+    return index;
+}
+
+void note_span_index::find( tick_type first, tick_type last, std::vector<size_t> &result) const
+{
+    const note_span *base = spans.empty() ? 0 : &spans[0];
+    query( first, last, [&]( const note_span &note) { result.push_back( &note - base); });
+}
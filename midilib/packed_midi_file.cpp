@@ -0,0 +1,153 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/make_shared.hpp>
+#include "include/packed_midi_file.hpp"
+
+namespace
+{
+    typedef packed_midi_track::arena_type arena_type;
+
+    /// Decoder handler that appends events to a packed track.
+    struct packed_track_builder
+    {
+        packed_track_builder( packed_midi_track &track, arena_type &arena)
+            : track( track), arena( arena)
+        {
+        }
+
+        void channel_event( unsigned delta_time, unsigned char status, unsigned char data1, unsigned char data2)
+        {
+            track.push_channel_event( delta_time, status, data1, data2);
+        }
+
+        void meta_event( unsigned delta_time, unsigned char type, decoding::byte_iterator data, size_t size)
+        {
+            track.push_payload_event( delta_time, 0xff, type, data, size, arena);
+        }
+
+        void sysex_event( unsigned delta_time, unsigned char status, decoding::byte_iterator data, size_t size)
+        {
+            track.push_payload_event( delta_time, status, 0, data, size, arena);
+        }
+
+        packed_midi_track &track;
+        arena_type &arena;
+    };
+
+    /// Visitor that appends midi_track events to a packed track.
+    struct packing_visitor : boost::static_visitor<>
+    {
+        packing_visitor( const midi_file &source, packed_midi_track &track, arena_type &arena)
+            : source( source), track( track), arena( arena), delta_time( 0)
+        {
+        }
+
+        void operator()( const events::timed_midi_event &event)
+        {
+            delta_time = event.delta_time;
+            boost::apply_visitor( *this, event.event);
+        }
+
+        void operator()( const events::channel_event &event)
+        {
+            unsigned char status, data1, data2;
+            decoding::split_channel_event( event, status, data1, data2);
+            track.push_channel_event( delta_time, status, data1, data2);
+        }
+
+        void operator()( const events::meta &event)
+        {
+            const unsigned char *payload = event.bytes.empty() ? 0 : &event.bytes[0];
+            track.push_payload_event( delta_time, 0xff, event.type, payload, event.bytes.size(), arena);
+        }
+
+        void operator()( const events::sysex &event)
+        {
+            track.push_payload_event( delta_time, event.status, 0, source.sysex_bytes( event), event.size, arena);
+        }
+
+        const midi_file   &source;
+        packed_midi_track &track;
+        arena_type &arena;
+        unsigned delta_time;
+    };
+
+    /// hand the arena over to the file and all of its tracks.
+    void freeze( packed_midi_file &file, arena_type &arena)
+    {
+        boost::shared_ptr<arena_type> shared = boost::make_shared<arena_type>();
+        shared->swap( arena);
+        arena_type( *shared).swap( *shared);
+        file.arena = shared;
+        for (packed_midi_file::tracks_type::iterator i = file.tracks.begin(); i != file.tracks.end(); ++i)
+        {
+            i->freeze( file.arena);
+        }
+    }
+}
+
+packed_midi_file::packed_midi_file( const midi_file &file)
+    : header( file.header), tracks( file.tracks.size())
+{
+    arena_type arena;
+    for (size_t track = 0; track != file.tracks.size(); ++track)
+    {
+        packing_visitor packer( file, tracks[track], arena);
+        for (midi_track::const_iterator i = file.tracks[track].begin(); i != file.tracks[track].end(); ++i)
+        {
+            packer( *i);
+        }
+    }
+    freeze( *this, arena);
+}
+
+size_t packed_midi_file::memory_usage() const
+{
+    size_t result = tracks.capacity() * sizeof( packed_midi_track);
+    for (tracks_type::const_iterator i = tracks.begin(); i != tracks.end(); ++i)
+    {
+        result += i->memory_usage();
+    }
+    if (arena) result += arena->capacity();
+    return result;
+}
+
+/// Decode a complete midi file into packed tracks.
+/// This follows the same rules as decoding::decode_midifile(), only the events are stored differently.
+bool decode_packed_midifile( const unsigned char *data, size_t size, packed_midi_file &result)
+{
+    using namespace decoding;
+
+    result.tracks.clear();
+    result.arena.reset();
+
+    byte_iterator first = data;
+    byte_iterator last = data + size;
+    arena_type arena;
+
+    if (first != last)
+    {
+        if (!read_header( first, last, result.header)) return false;
+
+        int running_status = -1;
+        while (first != last)
+        {
+            unsigned chunk_size = 0;
+            if (!read_chunk_header( first, last, "MTrk", chunk_size) || size_t( last - first) < chunk_size) return false;
+
+            result.tracks.push_back( packed_midi_track());
+            packed_track_builder builder( result.tracks.back(), arena);
+            if (!decode_track_events( first, first + chunk_size, running_status, builder)) return false;
+            first += chunk_size;
+        }
+    }
+
+    freeze( result, arena);
+    return true;
+}
@@ -0,0 +1,91 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <stdexcept>
+#include <utility> // for move
+#include <algorithm> // for push_heap, pop_heap, make_heap
+#include "include/shared_midi_file.hpp"
+
+shared_midi_file::shared_midi_file( midi_file &&file)
+    : parsed_file( std::move( file)), file_index( parsed_file)
+{
+}
+
+shared_midi_file::pointer shared_midi_file::create( midi_file &&file)
+{
+    return pointer( new shared_midi_file( std::move( file)));
+}
+
+shared_midi_file::pointer shared_midi_file::load( const std::string &filename, const parse_options &options)
+{
+    midi_file file;
+    if (!parse_midifile( filename, file, options))
+    {
+        throw std::runtime_error( filename + " is not a valid midi file");
+    }
+    return create( std::move( file));
+}
+
+midi_cursor shared_midi_file::cursor( tick_type tick) const
+{
+    return midi_cursor( shared_from_this(), tick);
+}
+
+midi_cursor::midi_cursor( const shared_midi_file::pointer &file, tick_type tick)
+    : shared_file( file), current_tick( tick)
+{
+    seek( tick);
+}
+
+events::timed_midi_event_ref midi_cursor::peek() const
+{
+    const size_t track = upcoming.front();
+    const midi_index::positions_type::value_type &position = positions[track];
+    return events::timed_midi_event_ref(
+        position.time,
+        static_cast<unsigned>( position.time - current_tick),
+        shared_file->file().tracks[track][position.event]);
+}
+
+events::timed_midi_event_ref midi_cursor::next()
+{
+    const events::timed_midi_event_ref result = peek();
+    current_tick = result.absolute_time;
+
+    // move the track of this event to the back of the heap and put it back if it has events left. Simultaneous
+    // events of the same track stay in front, because that track still has the lowest index of all tracks at this
+    // time, so they are offered together, just like the multiplexer does.
+    std::pop_heap( upcoming.begin(), upcoming.end(), later( positions));
+    const midi_track &track = shared_file->file().tracks[upcoming.back()];
+    midi_index::positions_type::value_type &position = positions[upcoming.back()];
+    if (++position.event < track.size())
+    {
+        position.time += track[position.event].delta_time;
+        std::push_heap( upcoming.begin(), upcoming.end(), later( positions));
+    }
+    else
+    {
+        upcoming.pop_back();
+    }
+
+    return result;
+}
+
+void midi_cursor::seek( tick_type tick)
+{
+    shared_file->index().positions( tick, positions);
+    current_tick = tick;
+
+    const midi_file::tracks_type &tracks = shared_file->file().tracks;
+    upcoming.clear();
+    for (size_t track = 0; track != positions.size(); ++track)
+    {
+        if (positions[track].event < tracks[track].size()) upcoming.push_back( track);
+    }
+    std::make_heap( upcoming.begin(), upcoming.end(), later( positions));
+}
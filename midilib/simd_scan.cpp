@@ -0,0 +1,268 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cstring> // for memchr, memcmp
+#include "include/simd_scan.hpp"
+
+// The vector implementations use function attributes to enable the instruction sets per function, so that the
+// library as a whole can still run on processors that lack them.
+#if (defined( __GNUC__) || defined( __clang__)) && (defined( __x86_64__) || defined( __i386__))
+#define MIDILIB_X86_SIMD 1
+#include <immintrin.h>
+#define MIDILIB_TARGET( instructions) __attribute__(( target( instructions)))
+#endif
+
+namespace decoding
+{
+    namespace simd
+    {
+        namespace
+        {
+            size_t decode_scalar( byte_iterator first, byte_iterator last, boost::uint32_t *out, size_t count, byte_iterator &end)
+            {
+                size_t decoded = 0;
+                byte_iterator current = first;
+                while (decoded < count)
+                {
+                    boost::uint32_t value = 0;
+                    byte_iterator byte = current;
+                    while (byte != last && (*byte & 0x80))
+                    {
+                        value = (value << 7) | (*byte++ & 0x7f);
+                    }
+                    if (byte == last) break;
+
+                    out[decoded++] = (value << 7) | *byte++;
+                    current = byte;
+                }
+                end = current;
+                return decoded;
+            }
+
+            byte_iterator find_scalar( byte_iterator first, byte_iterator last, const char *signature)
+            {
+                while (last - first >= 4)
+                {
+                    const void *candidate = std::memchr( first, signature[0], (last - first) - 3);
+                    if (!candidate) break;
+                    first = static_cast<byte_iterator>( candidate);
+                    if (std::memcmp( first, signature, 4) == 0) return first;
+                    ++first;
+                }
+                return last;
+            }
+
+#if defined( MIDILIB_X86_SIMD)
+            /// decode the quantities that end in a block of bytes, given the bit mask of their terminating bytes.
+            /// Returns the number of bytes in the block that were consumed.
+            unsigned decode_terminated( byte_iterator block, unsigned terminators, boost::uint32_t *out, size_t count, size_t &decoded)
+            {
+                unsigned start = 0;
+                while (terminators && decoded < count)
+                {
+                    const unsigned stop = __builtin_ctz( terminators);
+                    boost::uint32_t value = 0;
+                    for (unsigned byte = start; byte <= stop; ++byte)
+                    {
+                        value = (value << 7) | (block[byte] & 0x7f);
+                    }
+                    out[decoded++] = value;
+                    start = stop + 1;
+                    terminators &= terminators - 1;
+                }
+                return start;
+            }
+
+            MIDILIB_TARGET( "sse2")
+            size_t decode_sse2( byte_iterator first, byte_iterator last, boost::uint32_t *out, size_t count, byte_iterator &end)
+            {
+                size_t decoded = 0;
+                byte_iterator current = first;
+                const __m128i zero = _mm_setzero_si128();
+                while (decoded < count && last - current >= 16)
+                {
+                    const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current));
+                    const unsigned continuations = _mm_movemask_epi8( block);
+                    if (continuations == 0 && count - decoded >= 16)
+                    {
+                        // sixteen single-byte quantities, which is the common case for delta times: widen to 32 bits.
+                        const __m128i low = _mm_unpacklo_epi8( block, zero);
+                        const __m128i high = _mm_unpackhi_epi8( block, zero);
+                        __m128i *destination = reinterpret_cast<__m128i *>( out + decoded);
+                        _mm_storeu_si128( destination + 0, _mm_unpacklo_epi16( low, zero));
+                        _mm_storeu_si128( destination + 1, _mm_unpackhi_epi16( low, zero));
+                        _mm_storeu_si128( destination + 2, _mm_unpacklo_epi16( high, zero));
+                        _mm_storeu_si128( destination + 3, _mm_unpackhi_epi16( high, zero));
+                        decoded += 16;
+                        current += 16;
+                    }
+                    else if (const unsigned terminators = ~continuations & 0xffff)
+                    {
+                        current += decode_terminated( current, terminators, out, count, decoded);
+                    }
+                    else
+                    {
+                        // a quantity of more than sixteen bytes.
+                        byte_iterator next = current;
+                        if (!decode_scalar( current, last, out + decoded, 1, next)) break;
+                        ++decoded;
+                        current = next;
+                    }
+                }
+                decoded += decode_scalar( current, last, out + decoded, count - decoded, end);
+                return decoded;
+            }
+
+            MIDILIB_TARGET( "avx2")
+            size_t decode_avx2( byte_iterator first, byte_iterator last, boost::uint32_t *out, size_t count, byte_iterator &end)
+            {
+                size_t decoded = 0;
+                byte_iterator current = first;
+                while (decoded < count && last - current >= 32)
+                {
+                    const __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( current));
+                    const unsigned continuations = static_cast<unsigned>( _mm256_movemask_epi8( block));
+                    if (continuations == 0 && count - decoded >= 32)
+                    {
+                        __m256i *destination = reinterpret_cast<__m256i *>( out + decoded);
+                        for (unsigned part = 0; part != 4; ++part)
+                        {
+                            const __m128i bytes = _mm_loadl_epi64( reinterpret_cast<const __m128i *>( current + 8 * part));
+                            _mm256_storeu_si256( destination + part, _mm256_cvtepu8_epi32( bytes));
+                        }
+                        decoded += 32;
+                        current += 32;
+                    }
+                    else if (const unsigned terminators = ~continuations)
+                    {
+                        current += decode_terminated( current, terminators, out, count, decoded);
+                    }
+                    else
+                    {
+                        byte_iterator next = current;
+                        if (!decode_scalar( current, last, out + decoded, 1, next)) break;
+                        ++decoded;
+                        current = next;
+                    }
+                }
+                decoded += decode_scalar( current, last, out + decoded, count - decoded, end);
+                return decoded;
+            }
+
+            /// find candidates by comparing the first and last signature characters at all sixteen (or thirty-two)
+            /// positions of a block at once, then confirm the candidates one by one.
+            MIDILIB_TARGET( "sse2")
+            byte_iterator find_sse2( byte_iterator first, byte_iterator last, const char *signature)
+            {
+                const __m128i head = _mm_set1_epi8( signature[0]);
+                const __m128i tail = _mm_set1_epi8( signature[3]);
+                while (last - first >= 16 + 3)
+                {
+                    const __m128i heads = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( first)), head);
+                    const __m128i tails = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( first + 3)), tail);
+                    for (unsigned bits = _mm_movemask_epi8( _mm_and_si128( heads, tails)); bits; bits &= bits - 1)
+                    {
+                        const byte_iterator candidate = first + __builtin_ctz( bits);
+                        if (std::memcmp( candidate + 1, signature + 1, 2) == 0) return candidate;
+                    }
+                    first += 16;
+                }
+                return find_scalar( first, last, signature);
+            }
+
+            MIDILIB_TARGET( "avx2")
+            byte_iterator find_avx2( byte_iterator first, byte_iterator last, const char *signature)
+            {
+                const __m256i head = _mm256_set1_epi8( signature[0]);
+                const __m256i tail = _mm256_set1_epi8( signature[3]);
+                while (last - first >= 64 + 3)
+                {
+                    // two blocks per iteration, so that the common case of no candidates costs a single branch.
+                    const __m256i first_heads = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( first)), head);
+                    const __m256i first_tails = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( first + 3)), tail);
+                    const __m256i second_heads = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( first + 32)), head);
+                    const __m256i second_tails = _mm256_cmpeq_epi8( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( first + 35)), tail);
+                    const __m256i first_candidates = _mm256_and_si256( first_heads, first_tails);
+                    const __m256i second_candidates = _mm256_and_si256( second_heads, second_tails);
+                    if (!_mm256_testz_si256( _mm256_or_si256( first_candidates, second_candidates), _mm256_or_si256( first_candidates, second_candidates)))
+                    {
+                        const boost::uint64_t bits =
+                            static_cast<boost::uint32_t>( _mm256_movemask_epi8( first_candidates))
+                            | (boost::uint64_t( static_cast<boost::uint32_t>( _mm256_movemask_epi8( second_candidates))) << 32);
+                        for (boost::uint64_t remaining = bits; remaining; remaining &= remaining - 1)
+                        {
+                            const byte_iterator candidate = first + __builtin_ctzll( remaining);
+                            if (std::memcmp( candidate + 1, signature + 1, 2) == 0) return candidate;
+                        }
+                    }
+                    first += 64;
+                }
+                return find_sse2( first, last, signature);
+            }
+#endif
+
+            instruction_set detect_instruction_set()
+            {
+#if defined( MIDILIB_X86_SIMD)
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports( "avx2")) return avx2_instructions;
+                if (__builtin_cpu_supports( "sse2")) return sse2_instructions;
+#endif
+                return scalar_instructions;
+            }
+
+            /// never use instructions that the processor doesn't support, whatever was asked for.
+            instruction_set supported( instruction_set requested)
+            {
+                return requested < best_instruction_set() ? requested : best_instruction_set();
+            }
+        }
+
+        instruction_set best_instruction_set()
+        {
+            static const instruction_set best = detect_instruction_set();
+            return best;
+        }
+
+        const char *instruction_set_name( instruction_set instructions)
+        {
+            switch (instructions)
+            {
+            case sse2_instructions: return "sse2";
+            case avx2_instructions: return "avx2";
+            default:                return "scalar";
+            }
+        }
+
+        size_t decode_variable_length_quantities(
+            byte_iterator first, byte_iterator last, boost::uint32_t *out, size_t count, byte_iterator &end,
+            instruction_set instructions)
+        {
+            switch (supported( instructions))
+            {
+#if defined( MIDILIB_X86_SIMD)
+            case avx2_instructions: return decode_avx2( first, last, out, count, end);
+            case sse2_instructions: return decode_sse2( first, last, out, count, end);
+#endif
+            default:                return decode_scalar( first, last, out, count, end);
+            }
+        }
+
+        byte_iterator find_signature( byte_iterator first, byte_iterator last, const char *signature, instruction_set instructions)
+        {
+            switch (supported( instructions))
+            {
+#if defined( MIDILIB_X86_SIMD)
+            case avx2_instructions: return find_avx2( first, last, signature);
+            case sse2_instructions: return find_sse2( first, last, signature);
+#endif
+            default:                return find_scalar( first, last, signature);
+            }
+        }
+    }
+}
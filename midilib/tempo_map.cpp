@@ -0,0 +1,147 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <algorithm>
+#include "include/tempo_map.hpp"
+
+namespace
+{
+    typedef tempo_map::tick_type tick_type;
+
+    const unsigned char tempo_meta_type = 81;
+
+    /// A tempo meta event found in one of the tracks of a file.
+    struct tempo_event
+    {
+        tick_type   tick;
+        size_t      track;
+        unsigned    tempo;
+
+        /// order of the multiplexer: chronological, simultaneous events in track order.
+        bool operator<( const tempo_event &other) const
+        {
+            return tick < other.tick || (tick == other.tick && track < other.track);
+        }
+    };
+
+    struct starts_after_tick
+    {
+        bool operator()( tick_type tick, const tempo_map::segment &segment) const
+        {
+            return tick < segment.tick;
+        }
+    };
+
+    struct starts_after_microseconds
+    {
+        bool operator()( boost::uint64_t microseconds, const tempo_map::segment &segment) const
+        {
+            return microseconds < segment.microseconds;
+        }
+    };
+
+    /// For SMPTE time division, return the number of ticks in 100 seconds, for PPQ time division return zero.
+    /// The upper byte of an SMPTE division is the negated number of frames per second, where 29 frames means 29.97 fps
+    /// (drop frame). The lower byte holds the number of ticks per frame.
+    boost::uint64_t smpte_ticks_per_100_seconds( unsigned division)
+    {
+        if (!(division & 0x8000))
+        {
+            return 0;
+        }
+        const unsigned fps = 0x100 - ((division >> 8) & 0xff);
+        const unsigned ticks_per_frame = division & 0xff;
+        return std::max<boost::uint64_t>( boost::uint64_t( fps == 29 ? 2997 : fps * 100) * ticks_per_frame, 1);
+    }
+}
+
+tempo_map::tempo_map( const midi_header &header)
+    : division( std::max( header.division, 1u)), ticks_per_100_seconds( smpte_ticks_per_100_seconds( header.division))
+{
+    segment initial = { 0, 0, default_tempo};
+    tempo_segments.push_back( initial);
+}
+
+tempo_map::tempo_map( const midi_file &file)
+    : division( std::max( file.header.division, 1u)), ticks_per_100_seconds( smpte_ticks_per_100_seconds( file.header.division))
+{
+    segment initial = { 0, 0, default_tempo};
+    tempo_segments.push_back( initial);
+
+    if (is_smpte())
+    {
+        return;
+    }
+
+    std::vector<tempo_event> tempo_events;
+    for (size_t track = 0; track < file.tracks.size(); ++track)
+    {
+        tick_type time = 0;
+        for (midi_track::const_iterator i = file.tracks[track].begin(); i != file.tracks[track].end(); ++i)
+        {
+            time += i->delta_time;
+            const events::meta *meta = boost::get<events::meta>( &i->event);
+            if (meta && meta->type == tempo_meta_type && meta->bytes.size() == 3)
+            {
+                const unsigned tempo = (meta->bytes[0] << 16) + (meta->bytes[1] << 8) + meta->bytes[2];
+                tempo_event e = { time, track, tempo};
+                tempo_events.push_back( e);
+            }
+        }
+    }
+
+    std::stable_sort( tempo_events.begin(), tempo_events.end());
+    for (std::vector<tempo_event>::const_iterator i = tempo_events.begin(); i != tempo_events.end(); ++i)
+    {
+        add_tempo_change( i->tick, i->tempo);
+    }
+}
+
+void tempo_map::add_tempo_change( tick_type tick, unsigned tempo)
+{
+    segment &last = tempo_segments.back();
+    if (last.tick == tick)
+    {
+        last.tempo = tempo;
+    }
+    else if (last.tempo != tempo)
+    {
+        segment next = { tick, ticks_to_microseconds( tick), tempo};
+        tempo_segments.push_back( next);
+    }
+}
+
+const tempo_map::segment &tempo_map::find_segment( tick_type tick) const
+{
+    // the first segment starts at zero, so upper_bound never returns the first segment.
+    return *(std::upper_bound( tempo_segments.begin(), tempo_segments.end(), tick, starts_after_tick()) - 1);
+}
+
+boost::uint64_t tempo_map::ticks_to_microseconds( tick_type tick) const
+{
+    if (is_smpte())
+    {
+        return tick * 100000000 / ticks_per_100_seconds;
+    }
+
+    const segment &s = find_segment( tick);
+    return s.microseconds + (tick - s.tick) * s.tempo / division;
+}
+
+tempo_map::tick_type tempo_map::microseconds_to_ticks( boost::uint64_t microseconds) const
+{
+    if (is_smpte())
+    {
+        return ((microseconds + 1) * ticks_per_100_seconds - 1) / 100000000;
+    }
+
+    const segment &s =
+        *(std::upper_bound( tempo_segments.begin(), tempo_segments.end(), microseconds, starts_after_microseconds()) - 1);
+    // the inverse of ticks_to_microseconds(): the largest tick that is mapped to at most the given time.
+    return s.tempo ? s.tick + ((microseconds - s.microseconds + 1) * division - 1) / s.tempo : s.tick;
+}
@@ -0,0 +1,92 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Differential test of the two parser backends: every file in the directories given on the command line is parsed
+/// with the spirit grammar and with the table decoder. Both must accept or reject the same files and, for accepted
+/// files, build identical midi_file structures.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "midilib/include/midi_parser.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    /// compare two parsed files, reporting the first difference.
+    bool compare( const std::string &name, const midi_file &spirit, const midi_file &table)
+    {
+        if (!(spirit.header == table.header))
+        {
+            std::cerr << name << ": headers differ\n";
+            return false;
+        }
+        if (spirit.tracks.size() != table.tracks.size())
+        {
+            std::cerr << name << ": " << spirit.tracks.size() << " tracks versus " << table.tracks.size() << '\n';
+            return false;
+        }
+        for (size_t track = 0; track != spirit.tracks.size(); ++track)
+        {
+            const midi_track &lhs = spirit.tracks[track];
+            const midi_track &rhs = table.tracks[track];
+            if (lhs.size() != rhs.size())
+            {
+                std::cerr << name << ": track " << track << " has " << lhs.size() << " events versus " << rhs.size() << '\n';
+                return false;
+            }
+            for (size_t event = 0; event != lhs.size(); ++event)
+            {
+                if (lhs[event].delta_time != rhs[event].delta_time || !(lhs[event].event == rhs[event].event))
+                {
+                    std::cerr << name << ": track " << track << " differs at event " << event << '\n';
+                    return false;
+                }
+            }
+        }
+        return spirit == table;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+    if (files.empty())
+    {
+        std::cerr << "usage: backend_equivalence <directory>...\n";
+        return 1;
+    }
+
+    unsigned failures = 0;
+    unsigned accepted = 0;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        const std::vector<unsigned char> bytes = read_test_file( *file);
+        const unsigned char *data = bytes.empty() ? 0 : &bytes[0];
+
+        midi_file spirit;
+        midi_file table;
+        const bool spirit_parsed = parse_midifile( data, bytes.size(), spirit, parse_options( parse_options::spirit_backend));
+        const bool table_parsed = parse_midifile( data, bytes.size(), table, parse_options( parse_options::table_backend));
+
+        if (spirit_parsed != table_parsed)
+        {
+            std::cerr << *file << ": spirit backend " << (spirit_parsed ? "accepts" : "rejects")
+                << " the file, table backend " << (table_parsed ? "accepts" : "rejects") << " it\n";
+            ++failures;
+        }
+        else if (spirit_parsed)
+        {
+            ++accepted;
+            if (!compare( *file, spirit, table)) ++failures;
+        }
+    }
+
+    std::cout << files.size() << " files, " << accepted << " accepted, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( COUNTING_RESOURCE_HPP)
+#define COUNTING_RESOURCE_HPP
+
+#include <cstddef> // for size_t
+#include <memory_resource>
+
+/// A memory resource that allocates from the default resource and keeps track of the largest number of bytes that
+/// were allocated at any time. A midi_file that is constructed with this resource allocates all of its tracks, events
+/// and payloads from it, so this measures the memory that parsing a file takes.
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    counting_resource()
+        : allocated( 0), peak_allocated( 0)
+    {
+    }
+
+    size_t peak() const
+    {
+        return peak_allocated;
+    }
+
+private:
+    void *do_allocate( size_t bytes, size_t alignment)
+    {
+        void *result = std::pmr::new_delete_resource()->allocate( bytes, alignment);
+        allocated += bytes;
+        if (allocated > peak_allocated) peak_allocated = allocated;
+        return result;
+    }
+
+    void do_deallocate( void *p, size_t bytes, size_t alignment)
+    {
+        std::pmr::new_delete_resource()->deallocate( p, bytes, alignment);
+        allocated -= bytes;
+    }
+
+    bool do_is_equal( const std::pmr::memory_resource &other) const noexcept
+    {
+        return this == &other;
+    }
+
+    size_t allocated;
+    size_t peak_allocated;
+};
+
+#endif //COUNTING_RESOURCE_HPP
@@ -0,0 +1,199 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test that a midi_cursor offers exactly the same sequence of events as a midi_multiplexer: from the start, after
+/// seek() and after a cursor is copied in the middle of the file. This is checked for every file in the directories
+/// given on the command line and for a generated file with many tracks and many simultaneous events.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <utility> // for move
+#include "midilib/include/shared_midi_file.hpp"
+#include "midilib/include/midi_multiplexer.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    /// an offered event: its times and the event in the file that it refers to.
+    struct offered_event
+    {
+        boost::uint64_t                     absolute_time;
+        unsigned                            delta_time;
+        const events::timed_midi_event      *event;
+    };
+
+    bool operator==( const offered_event &lhs, const offered_event &rhs)
+    {
+        return lhs.absolute_time == rhs.absolute_time && lhs.delta_time == rhs.delta_time && lhs.event == rhs.event;
+    }
+
+    offered_event offered( const events::timed_midi_event_ref &ref)
+    {
+        const offered_event result = { ref.absolute_time, ref.delta_time, &ref.event};
+        return result;
+    }
+
+    typedef std::vector<offered_event> sequence;
+
+    struct recorder
+    {
+        explicit recorder( sequence &events)
+            : events( events)
+        {
+        }
+
+        void operator()( const events::timed_midi_event_ref &ref) const
+        {
+            events.push_back( offered( ref));
+        }
+
+        sequence &events;
+    };
+
+    /// the events that the multiplexer offers from the given time on, with the delta time of the first event
+    /// relative to that time.
+    sequence expected_from( const sequence &all, boost::uint64_t tick)
+    {
+        sequence result;
+        boost::uint64_t previous = tick;
+        for (sequence::const_iterator event = all.begin(); event != all.end(); ++event)
+        {
+            if (event->absolute_time >= tick)
+            {
+                offered_event copy = *event;
+                copy.delta_time = static_cast<unsigned>( copy.absolute_time - previous);
+                previous = copy.absolute_time;
+                result.push_back( copy);
+            }
+        }
+        return result;
+    }
+
+    /// take at most 'count' events from the cursor. Every event must be announced by peek() before next() offers it.
+    sequence take( midi_cursor &cursor, size_t count = static_cast<size_t>( -1))
+    {
+        sequence result;
+        for (; count && !cursor.at_end(); --count)
+        {
+            const offered_event peeked = offered( cursor.peek());
+            result.push_back( offered( cursor.next()));
+            if (!(peeked == result.back()))
+            {
+                // an event that no multiplexer offers, so that the comparison fails at this point.
+                const offered_event mismatch = { 0, 0, 0};
+                result.back() = mismatch;
+            }
+        }
+        return result;
+    }
+
+    bool compare( const std::string &name, const std::string &what, const sequence &expected, const sequence &actual)
+    {
+        if (expected.size() != actual.size())
+        {
+            std::cerr << name << ", " << what << ": the cursor offers " << actual.size() << " events instead of " << expected.size() << '\n';
+            return false;
+        }
+        for (size_t event = 0; event != expected.size(); ++event)
+        {
+            if (!(expected[event] == actual[event]))
+            {
+                std::cerr << name << ", " << what << ": the cursor differs at event " << event << '\n';
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool check_file( const std::string &name, const shared_midi_file::pointer &file)
+    {
+        sequence all;
+        midi_multiplexer( file->file().tracks).accept( recorder( all));
+        const boost::uint64_t end = all.empty() ? 0 : all.back().absolute_time;
+
+        midi_cursor cursor = file->cursor();
+        if (!compare( name, "from the start", all, take( cursor))) return false;
+
+        // seek to random times, to the times of events and beyond the end.
+        std::mt19937_64 random( 2012);
+        std::uniform_int_distribution<boost::uint64_t> time( 0, end + 1);
+        std::uniform_int_distribution<size_t> pick( 0, all.empty() ? 0 : all.size() - 1);
+        for (unsigned seek = 0; seek != 20; ++seek)
+        {
+            const boost::uint64_t tick = (seek % 2 || all.empty()) ? time( random) : all[pick( random)].absolute_time;
+            cursor.seek( tick);
+            if (!compare( name, "after seek( " + std::to_string( tick) + ")", expected_from( all, tick), take( cursor))) return false;
+        }
+
+        // copy a cursor halfway through the file, both must continue independently.
+        if (!all.empty())
+        {
+            const size_t half = all.size() / 2;
+            midi_cursor original = file->cursor();
+            const sequence first_half = take( original, half);
+            midi_cursor copy = original;
+            const sequence original_rest = take( original);
+            const sequence copy_rest = take( copy);
+            const sequence expected_rest( all.begin() + half, all.end());
+            if (   !compare( name, "first half", sequence( all.begin(), all.begin() + half), first_half)
+                || !compare( name, "original after copying", expected_rest, original_rest)
+                || !compare( name, "copy", expected_rest, copy_rest))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// many tracks with events on a small number of distinct times, so that most events are simultaneous with events
+    /// in other tracks, and some tracks have several events at the same time.
+    shared_midi_file::pointer make_crowded_file()
+    {
+        std::mt19937 random( 2012);
+        std::uniform_int_distribution<unsigned> delta( 0, 3);
+        std::uniform_int_distribution<unsigned> length( 0, 200);
+
+        midi_file file;
+        file.header.format = 1;
+        file.header.number_of_tracks = 300;
+        file.header.division = 96;
+        file.tracks.resize( file.header.number_of_tracks);
+        for (size_t track = 0; track != file.tracks.size(); ++track)
+        {
+            const unsigned count = length( random);
+            for (unsigned event = 0; event != count; ++event)
+            {
+                events::channel_event channel;
+                channel.channel = track % 16;
+                channel.event = events::program_change( static_cast<unsigned char>( event % 128));
+                events::timed_midi_event timed;
+                timed.delta_time = delta( random) * 10;
+                timed.event = channel;
+                file.tracks[track].push_back( timed);
+            }
+        }
+        return shared_midi_file::create( std::move( file));
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+
+    unsigned failures = 0;
+    if (!check_file( "crowded", make_crowded_file())) ++failures;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        if (!check_file( *file, shared_midi_file::load( *file, parse_options( parse_options::table_backend)))) ++failures;
+    }
+
+    std::cout << files.size() + 1 << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
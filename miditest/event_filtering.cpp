@@ -0,0 +1,227 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test of parsing with an event filter. For every file in the directories given on the command line and for several
+/// filters, a filtered track must hold exactly the events of the unfiltered track that pass the filter, at the same
+/// absolute times. Crafted tracks check that a delta time that no longer fits after adding the time of rejected events
+/// makes the file fail, and what happens to the time after the last kept event.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility> // for pair
+#include <boost/cstdint.hpp>
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_decoder.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    typedef std::vector<unsigned char> bytes_type;
+
+    /// Visitor that determines whether a filter accepts an event.
+    struct filter_check : boost::static_visitor<bool>
+    {
+        explicit filter_check( const event_filter &filter)
+            : filter( filter)
+        {
+        }
+
+        bool operator()( const events::channel_event &event) const
+        {
+            unsigned char status, data1, data2;
+            decoding::split_channel_event( event, status, data1, data2);
+            return filter.accepts_channel_event( status);
+        }
+
+        bool operator()( const events::meta &event) const
+        {
+            return filter.accepts_meta_event( event.type);
+        }
+
+        bool operator()( const events::sysex &) const
+        {
+            return filter.accepts_sysex_event();
+        }
+
+        const event_filter &filter;
+    };
+
+    /// the events of a track that pass the filter, with their delta times changed to keep their absolute times.
+    midi_track expected_track( const midi_track &track, const event_filter &filter)
+    {
+        midi_track result;
+        boost::uint64_t skipped = 0;
+        for (midi_track::const_iterator event = track.begin(); event != track.end(); ++event)
+        {
+            skipped += event->delta_time;
+            if (boost::apply_visitor( filter_check( filter), event->event))
+            {
+                result.push_back( *event);
+                result.back().delta_time = static_cast<unsigned>( skipped);
+                skipped = 0;
+            }
+        }
+        return result;
+    }
+
+    bool check_filter( const std::string &name, const std::string &filter_name, const midi_file &original, const event_filter &filter)
+    {
+        midi_file filtered;
+        parse_options options( parse_options::table_backend);
+        options.filter = filter;
+        if (!parse_midifile( name, filtered, options) || filtered.tracks.size() != original.tracks.size())
+        {
+            std::cerr << name << ": can't be parsed with filter " << filter_name << '\n';
+            return false;
+        }
+        for (size_t track = 0; track != original.tracks.size(); ++track)
+        {
+            if (!(filtered.tracks[track] == expected_track( original.tracks[track], filter)))
+            {
+                std::cerr << name << ": track " << track << " differs with filter " << filter_name << '\n';
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void append_variable_length_quantity( bytes_type &bytes, size_t value)
+    {
+        unsigned char groups[10];
+        unsigned count = 0;
+        do
+        {
+            groups[count++] = value & 0x7f;
+            value >>= 7;
+        } while (value);
+        while (--count)
+        {
+            bytes.push_back( groups[count] | 0x80);
+        }
+        bytes.push_back( groups[0]);
+    }
+
+    /// a format 0 file with a single track.
+    bytes_type make_file( const bytes_type &track)
+    {
+        bytes_type result = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96, 'M', 'T', 'r', 'k'};
+        for (unsigned shift = 32; shift;)
+        {
+            shift -= 8;
+            result.push_back( static_cast<unsigned char>( track.size() >> shift));
+        }
+        result.insert( result.end(), track.begin(), track.end());
+        return result;
+    }
+
+    /// a track with 'count' text events, each with the largest possible delta time, followed by a note and an
+    /// end-of-track event.
+    bytes_type make_long_gap_track( unsigned count)
+    {
+        bytes_type track;
+        for (unsigned text = 0; text != count; ++text)
+        {
+            append_variable_length_quantity( track, 0x0fffffff);
+            track.insert( track.end(), { 0xff, 0x01, 0x01, 'a'});
+        }
+        track.insert( track.end(), { 0, 0x90, 60, 100, 0, 0xff, 0x2f, 0});
+        return track;
+    }
+
+    bool check_long_gaps()
+    {
+        parse_options options( parse_options::table_backend);
+        options.filter = event_filter( event_filter::note_events);
+
+        // sixteen gaps still fit in a 32-bit delta time, seventeen don't.
+        const bytes_type fits = make_file( make_long_gap_track( 16));
+        const bytes_type too_long = make_file( make_long_gap_track( 17));
+        midi_file result;
+        if (   !parse_midifile( &fits[0], fits.size(), result, options)
+            || result.tracks.size() != 1 || result.tracks[0].size() != 1
+            || result.tracks[0][0].delta_time != 16u * 0x0fffffff)
+        {
+            std::cerr << "long gaps: a delta time that fits is not kept\n";
+            return false;
+        }
+        if (parse_midifile( &too_long[0], too_long.size(), result, options))
+        {
+            std::cerr << "long gaps: a delta time that doesn't fit is accepted\n";
+            return false;
+        }
+        return true;
+    }
+
+    /// the time of rejected events after the last kept event is dropped, unless the end-of-track event is kept.
+    bool check_trailing_time()
+    {
+        const bytes_type track = { 0, 0x90, 60, 100, 100, 0xff, 0x01, 0x01, 'a', 50, 0xff, 0x2f, 0};
+
+        midi_track notes;
+        event_filter note_filter( event_filter::note_events);
+        decoding::filtering_track_builder builder( notes, 0, note_filter);
+        int running_status = -1;
+        if (   !decoding::decode_track_events( &track[0], &track[0] + track.size(), running_status, builder)
+            || notes.size() != 1 || builder.trailing_time() != 150)
+        {
+            std::cerr << "trailing time: the time after the last note is not reported\n";
+            return false;
+        }
+
+        event_filter with_end = note_filter;
+        with_end.types |= event_filter::meta_events;
+        with_end.meta_types.reset();
+        with_end.meta_types.set( 0x2f);
+        const bytes_type file = make_file( track);
+        midi_file result;
+        parse_options options( parse_options::table_backend);
+        options.filter = with_end;
+        if (   !parse_midifile( &file[0], file.size(), result, options)
+            || result.tracks.size() != 1 || result.tracks[0].size() != 2 || result.tracks[0][1].delta_time != 150)
+        {
+            std::cerr << "trailing time: a kept end-of-track event doesn't keep the length of the track\n";
+            return false;
+        }
+        return true;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+
+    std::vector<std::pair<std::string, event_filter> > filters;
+    filters.push_back( std::make_pair( "notes", event_filter( event_filter::note_events)));
+    filters.push_back( std::make_pair( "meta", event_filter::meta_only()));
+    filters.push_back( std::make_pair( "lyrics", event_filter::meta_only( 5)));
+    filters.push_back( std::make_pair( "channel 0", event_filter::channel( event_filter::channel_events, 0)));
+    filters.push_back( std::make_pair( "no events", event_filter( 0)));
+
+    unsigned failures = 0;
+    if (!check_long_gaps()) ++failures;
+    if (!check_trailing_time()) ++failures;
+
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        midi_file original;
+        if (!parse_midifile( *file, original, parse_options( parse_options::table_backend)))
+        {
+            std::cerr << *file << ": can't be parsed\n";
+            ++failures;
+            continue;
+        }
+        for (size_t filter = 0; filter != filters.size(); ++filter)
+        {
+            if (!check_filter( *file, filters[filter].first, original, filters[filter].second)) ++failures;
+        }
+    }
+
+    std::cout << files.size() << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Fuzz target for parse_midifile with the limits for untrusted input.
+/// Built with MIDILIB_LIBFUZZER (see CMakeLists.txt), this is a libFuzzer target. Otherwise a main function runs
+/// the target once for every file in the directories given on the command line, which is how the corpus is
+/// checked as a regular test. Either way, an input that makes the parser allocate more than the memory budget
+/// aborts, and without libFuzzer an input that takes longer than the time budget fails the test.
+
+#include <cstdlib> // for abort
+#include <cstddef> // for size_t
+#include <boost/cstdint.hpp>
+#include "midilib/include/midi_parser.hpp"
+#include "counting_resource.hpp"
+
+namespace
+{
+    /// the memory that parsing may take: the memory limit plus a margin for allocator and bookkeeping overhead that
+    /// the limit doesn't count.
+    size_t memory_budget()
+    {
+        return decode_limits::untrusted().max_file_memory + decode_limits::untrusted().max_file_memory / 2;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput( const boost::uint8_t *data, size_t size)
+{
+    parse_options options( parse_options::table_backend);
+    options.capture_sysex = true;
+    options.limits = decode_limits::untrusted();
+
+    counting_resource resource;
+    {
+        midi_file result( &resource);
+        parse_midifile( data, size, result, options);
+    }
+    if (resource.peak() > memory_budget()) std::abort();
+    return 0;
+}
+
+#if !defined( MIDILIB_LIBFUZZER)
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "test_files.hpp"
+
+int main( int argc, char *argv[])
+{
+    typedef std::chrono::steady_clock clock_type;
+    const double time_budget = 1.0; // seconds per input
+
+    const std::vector<std::string> files = test_files( argc, argv);
+    if (files.empty())
+    {
+        std::cerr << "usage: fuzz_parser <directory>...\n";
+        return 1;
+    }
+
+    unsigned failures = 0;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        const std::vector<unsigned char> bytes = read_test_file( *file);
+        const clock_type::time_point start = clock_type::now();
+        LLVMFuzzerTestOneInput( bytes.empty() ? 0 : &bytes[0], bytes.size());
+        const double seconds = std::chrono::duration<double>( clock_type::now() - start).count();
+        if (seconds > time_budget)
+        {
+            std::cerr << *file << ": took " << seconds << " seconds\n";
+            ++failures;
+        }
+    }
+
+    std::cout << files.size() << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
+#endif
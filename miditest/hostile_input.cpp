@@ -0,0 +1,230 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test of decode_limits with crafted files that each try to make the parser allocate too much memory. Every file
+/// must be rejected within a fixed time and memory budget. As a control, the files in the directories given on the
+/// command line must still be accepted within the limits for untrusted input.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_validator.hpp"
+#include "counting_resource.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    typedef std::vector<unsigned char> bytes_type;
+    typedef std::chrono::steady_clock clock_type;
+
+    const double time_budget = 1.0; // seconds per file
+
+    void append_variable_length_quantity( bytes_type &bytes, size_t value)
+    {
+        unsigned char groups[10];
+        unsigned count = 0;
+        do
+        {
+            groups[count++] = value & 0x7f;
+            value >>= 7;
+        } while (value);
+        while (--count)
+        {
+            bytes.push_back( groups[count] | 0x80);
+        }
+        bytes.push_back( groups[0]);
+    }
+
+    void append_big_endian( bytes_type &bytes, size_t value, unsigned count)
+    {
+        while (count--)
+        {
+            bytes.push_back( static_cast<unsigned char>( value >> (8 * count)));
+        }
+    }
+
+    /// a format 1 file with the given track chunk contents.
+    bytes_type make_file( const std::vector<bytes_type> &tracks)
+    {
+        const unsigned char header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1};
+        bytes_type result( header, header + sizeof header);
+        append_big_endian( result, tracks.size(), 2);
+        append_big_endian( result, 96, 2);
+        for (std::vector<bytes_type>::const_iterator track = tracks.begin(); track != tracks.end(); ++track)
+        {
+            result.insert( result.end(), { 'M', 'T', 'r', 'k'});
+            append_big_endian( result, track->size(), 4);
+            result.insert( result.end(), track->begin(), track->end());
+        }
+        return result;
+    }
+
+    void append_end_of_track( bytes_type &track)
+    {
+        track.insert( track.end(), { 0, 0xff, 0x2f, 0});
+    }
+
+    /// a track with the given number of note-on events, using running status.
+    bytes_type make_notes( size_t count)
+    {
+        bytes_type track;
+        track.reserve( 3 * count + 5);
+        track.insert( track.end(), { 0, 0x90, 60, 100});
+        for (size_t note = 1; note < count; ++note)
+        {
+            track.insert( track.end(), { 0, 60, 100});
+        }
+        append_end_of_track( track);
+        return track;
+    }
+
+    /// parse the file, from memory or from a stream, and check the outcome, the time and the memory it took.
+    bool check( const std::string &name, const bytes_type &file, const decode_limits &limits, bool expect_accepted, size_t memory_budget, bool from_stream = false)
+    {
+        parse_options options( parse_options::table_backend);
+        options.capture_sysex = true;
+        options.limits = limits;
+
+        counting_resource resource;
+        bool accepted = false;
+        const clock_type::time_point start = clock_type::now();
+        {
+            midi_file result( &resource);
+            if (from_stream)
+            {
+                std::istringstream stream( std::string( file.begin(), file.end()));
+                accepted = parse_midifile( stream, result, options);
+            }
+            else
+            {
+                accepted = parse_midifile( file.empty() ? 0 : &file[0], file.size(), result, options);
+            }
+        }
+        const double seconds = std::chrono::duration<double>( clock_type::now() - start).count();
+
+        bool passed = true;
+        if (accepted != expect_accepted)
+        {
+            std::cerr << name << ": the file was " << (accepted ? "accepted" : "rejected") << '\n';
+            passed = false;
+        }
+        if (seconds > time_budget)
+        {
+            std::cerr << name << ": took " << seconds << " seconds\n";
+            passed = false;
+        }
+        if (resource.peak() > memory_budget)
+        {
+            std::cerr << name << ": allocated " << resource.peak() << " bytes\n";
+            passed = false;
+        }
+        return passed;
+    }
+
+    /// recover a file with one track that takes more memory than the file may, followed by a small track. The large
+    /// track must be skipped without counting against the memory of the small one, which must be kept.
+    bool check_recovery( const decode_limits &untrusted)
+    {
+        parse_options options( parse_options::table_backend);
+        options.limits = untrusted;
+        options.limits.max_file_memory = 1024 * 1024;
+
+        std::vector<bytes_type> tracks;
+        tracks.push_back( make_notes( 200000));
+        tracks.push_back( make_notes( 10));
+        const bytes_type file = make_file( tracks);
+
+        midi_validation validation = validate_midifile( &file[0], file.size());
+        midi_file result;
+        if (!recover_midifile( &file[0], file.size(), validation, result, options))
+        {
+            std::cerr << "recovery after an oversized track: the header was rejected\n";
+            return false;
+        }
+        if (   result.tracks.size() != 1 || result.tracks[0].size() != 11
+            || validation.chunks.size() != 2
+            || validation.chunks[0].status != chunk_validation::malformed_track
+            || validation.chunks[1].status != chunk_validation::valid_track)
+        {
+            std::cerr << "recovery after an oversized track: the small track was not kept\n";
+            return false;
+        }
+        return true;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const decode_limits untrusted = decode_limits::untrusted();
+    const size_t small_budget = 64 * 1024;
+    unsigned failures = 0;
+
+    {
+        // a meta event that claims to be 256MB long.
+        bytes_type track = { 0, 0xff, 0x01};
+        append_variable_length_quantity( track, 0x0fffffff);
+        track.push_back( 'a');
+        append_end_of_track( track);
+        if (!check( "huge meta length", make_file( std::vector<bytes_type>( 1, track)), untrusted, false, small_budget)) ++failures;
+    }
+
+    {
+        // a sysex event with a payload that is actually present, but larger than the payload limit.
+        bytes_type track = { 0, 0xf0};
+        const size_t size = 2 * untrusted.max_payload_size;
+        append_variable_length_quantity( track, size);
+        track.resize( track.size() + size, 0x11);
+        append_end_of_track( track);
+        if (!check( "huge sysex payload", make_file( std::vector<bytes_type>( 1, track)), untrusted, false, small_budget)) ++failures;
+    }
+
+    {
+        // a delta time of five bytes.
+        bytes_type track = { 0x81, 0x80, 0x80, 0x80, 0x00, 0x90, 60, 100};
+        append_end_of_track( track);
+        if (!check( "long variable length quantity", make_file( std::vector<bytes_type>( 1, track)), untrusted, false, small_budget)) ++failures;
+    }
+
+    {
+        // a track with more events than the limit allows.
+        const bytes_type file = make_file( std::vector<bytes_type>( 1, make_notes( untrusted.max_events_per_track + 1)));
+        if (!check( "too many events", file, untrusted, false, small_budget)) ++failures;
+    }
+
+    {
+        // tracks that are each within the limits, but together take more memory than the file may.
+        decode_limits limits = untrusted;
+        limits.max_file_memory = 1024 * 1024;
+        const bytes_type file = make_file( std::vector<bytes_type>( 16, make_notes( 10000)));
+        if (!check( "file memory", file, limits, false, limits.max_file_memory + limits.max_file_memory / 2)) ++failures;
+    }
+
+    {
+        // a stream that is larger than the maximum file size must not be read completely.
+        decode_limits limits = untrusted;
+        limits.max_file_size = 1024 * 1024;
+        const bytes_type file = make_file( std::vector<bytes_type>( 4, make_notes( 200000)));
+        if (!check( "file size", file, limits, false, small_budget, true)) ++failures;
+    }
+
+    if (!check_recovery( untrusted)) ++failures;
+
+    // real files must be accepted within the same budget as the fuzz target.
+    const std::vector<std::string> files = test_files( argc, argv);
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        if (!check( *file, read_test_file( *file), untrusted, true, untrusted.max_file_memory)) ++failures;
+        if (!check( *file + " (stream)", read_test_file( *file), untrusted, true, untrusted.max_file_memory, true)) ++failures;
+    }
+
+    std::cout << 7 + 2 * files.size() << " cases, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
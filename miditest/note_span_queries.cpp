@@ -0,0 +1,238 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test of note span extraction and of the note span index.
+/// A crafted file checks the pairing of note events: zero-length notes, note-on events with velocity zero, keys that
+/// are struck again while they sound and notes that are never ended. For that file and for every file in the
+/// directories given on the command line, note_span_index::find() must report the same notes as a brute-force scan,
+/// for random time windows and single ticks.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm> // for sort, max
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/note_spans.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    typedef note_span::tick_type tick_type;
+
+    /// builds a track from events with absolute times.
+    struct track_builder
+    {
+        explicit track_builder( midi_track &track)
+            : track( track), time( 0)
+        {
+        }
+
+        void note( tick_type at, unsigned char channel, bool on, unsigned char key, unsigned char velocity)
+        {
+            events::channel_event event;
+            event.channel = channel;
+            if (on)
+            {
+                events::note_on note;
+                note.number = key;
+                note.velocity = velocity;
+                event.event = note;
+            }
+            else
+            {
+                events::note_off note;
+                note.number = key;
+                note.velocity = velocity;
+                event.event = note;
+            }
+            append( at, event);
+        }
+
+        void end_of_track( tick_type at)
+        {
+            events::meta meta;
+            meta.type = 0x2f;
+            append( at, meta);
+        }
+
+        void append( tick_type at, const events::midi_event &event)
+        {
+            events::timed_midi_event timed;
+            timed.delta_time = static_cast<unsigned>( at - time);
+            timed.event = event;
+            track.push_back( timed);
+            time = at;
+        }
+
+        midi_track  &track;
+        tick_type   time;
+    };
+
+    midi_file make_pairing_file()
+    {
+        midi_file file;
+        file.header.format = 1;
+        file.header.number_of_tracks = 2;
+        file.header.division = 96;
+        file.tracks.resize( 2);
+
+        track_builder first( file.tracks[0]);
+        first.note(  0, 0, true,  60, 100);     // a note without duration
+        first.note(  0, 0, false, 60, 64);
+        first.note( 10, 0, true,  62, 90);
+        first.note( 15, 1, true,  62, 70);      // the same key on another channel
+        first.note( 20, 0, true,  62, 80);      // struck again while it sounds
+        first.note( 25, 1, false, 62, 64);
+        first.note( 30, 0, true,  62, 0);       // velocity zero ends the earliest note
+        first.note( 40, 0, false, 62, 64);
+        first.note( 50, 0, true,  64, 100);     // never ended
+        first.note( 60, 0, false, 65, 64);      // a note-off without a note
+        first.end_of_track( 70);
+
+        track_builder second( file.tracks[1]);
+        second.note( 80, 0, false, 64, 64);     // doesn't end the note of the other track
+        second.end_of_track( 100);
+        return file;
+    }
+
+    bool check_pairing( const midi_file &file)
+    {
+        struct expected_span
+        {
+            tick_type       start;
+            tick_type       end;
+            unsigned char   channel;
+            unsigned char   key;
+            unsigned char   velocity;
+        };
+        const expected_span expected[] = {
+            {  0,   0, 0, 60, 100},
+            { 10,  30, 0, 62, 90},
+            { 15,  25, 1, 62, 70},
+            { 20,  40, 0, 62, 80},
+            { 50, 100, 0, 64, 100}};
+        const size_t count = sizeof expected / sizeof expected[0];
+
+        note_span_vector notes;
+        extract_note_spans( file, notes);
+        if (notes.size() != count)
+        {
+            std::cerr << "pairing: " << notes.size() << " notes instead of " << count << '\n';
+            return false;
+        }
+        for (size_t note = 0; note != count; ++note)
+        {
+            if (   notes[note].start != expected[note].start || notes[note].end != expected[note].end
+                || notes[note].track != 0 || notes[note].channel != expected[note].channel
+                || notes[note].key != expected[note].key || notes[note].velocity != expected[note].velocity)
+            {
+                std::cerr << "pairing: note " << note << " is [" << notes[note].start << ", " << notes[note].end
+                    << ") on channel " << unsigned( notes[note].channel) << ", key " << unsigned( notes[note].key) << '\n';
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// the notes that sound in [first, last), as documented for note_span_index::query.
+    std::vector<size_t> brute_force( const note_span_vector &notes, tick_type first, tick_type last)
+    {
+        std::vector<size_t> result;
+        for (size_t note = 0; note != notes.size(); ++note)
+        {
+            const tick_type end = std::max( notes[note].end, notes[note].start + 1);
+            if (first < last && notes[note].start < last && end > first) result.push_back( note);
+        }
+        return result;
+    }
+
+    bool check_window( const std::string &name, const note_span_index &index, tick_type first, tick_type last)
+    {
+        std::vector<size_t> found;
+        index.find( first, last, found);
+        std::sort( found.begin(), found.end());
+        if (found != brute_force( index.notes(), first, last))
+        {
+            std::cerr << name << ": find( " << first << ", " << last << ") reports " << found.size()
+                << " notes, a scan finds " << brute_force( index.notes(), first, last).size() << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    /// compare find() with a brute-force scan for every tick around the notes, for random windows and for windows
+    /// that start or end at note boundaries.
+    bool check_queries( const std::string &name, const midi_file &file)
+    {
+        note_span_vector notes;
+        extract_note_spans( file, notes);
+        const note_span_index index( notes);
+
+        tick_type end = 1;
+        for (note_span_vector::const_iterator note = notes.begin(); note != notes.end(); ++note)
+        {
+            end = std::max( end, note->end + 2);
+        }
+
+        std::mt19937_64 random( 2012);
+        std::uniform_int_distribution<tick_type> time( 0, end);
+        std::uniform_int_distribution<size_t> pick( 0, notes.empty() ? 0 : notes.size() - 1);
+        for (unsigned window = 0; window != 2000; ++window)
+        {
+            tick_type first = time( random);
+            tick_type last = time( random);
+            if (last < first) std::swap( first, last);
+            if (!check_window( name, index, first, last)) return false;
+
+            if (!notes.empty())
+            {
+                const note_span &note = notes[pick( random)];
+                if (   !check_window( name, index, note.start, note.start + 1)
+                    || !check_window( name, index, note.end, note.end + 1)
+                    || !check_window( name, index, first, note.end)
+                    || !check_window( name, index, note.start, last))
+                {
+                    return false;
+                }
+            }
+        }
+
+        // empty and reversed windows, and windows beyond the end.
+        return check_window( name, index, 5, 5) && check_window( name, index, 10, 5) && check_window( name, index, 0, end)
+            && check_window( name, index, end, end + 100);
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+
+    unsigned failures = 0;
+    const midi_file pairing_file = make_pairing_file();
+    if (!check_pairing( pairing_file)) ++failures;
+    if (!check_queries( "pairing", pairing_file)) ++failures;
+
+    // an index without notes.
+    if (!check_queries( "empty", midi_file())) ++failures;
+
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        midi_file parsed;
+        if (!parse_midifile( *file, parsed, parse_options( parse_options::table_backend)))
+        {
+            std::cerr << *file << ": can't be parsed\n";
+            ++failures;
+            continue;
+        }
+        if (!check_queries( *file, parsed)) ++failures;
+    }
+
+    std::cout << files.size() + 2 << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test that iterating a packed_midi_file yields the same events as the midi_file it was made from. For every file in
+/// the directories given on the command line and for a crafted file with sysex packets and empty meta events, this is
+/// checked for a packed copy of the parsed file and for a file that was decoded directly into packed tracks.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/packed_midi_file.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    typedef std::vector<unsigned char> bytes_type;
+
+    /// the payload of an event if it is a sysex event, sysex events of a packed file refer to the arena of that file
+    /// instead of to the sysex_data of a midi_file.
+    template<typename SysexSource>
+    bytes_type sysex_payload( const SysexSource &source, const events::timed_midi_event &event)
+    {
+        bytes_type result;
+        if (const events::sysex *sysex = boost::get<events::sysex>( &event.event))
+        {
+            const unsigned char *bytes = source.sysex_bytes( *sysex);
+            result.assign( bytes, bytes + sysex->size);
+        }
+        return result;
+    }
+
+    bool same_event( const midi_file &file, const events::timed_midi_event &expected, const packed_midi_file &packed, const events::timed_midi_event &actual)
+    {
+        const events::sysex *expected_sysex = boost::get<events::sysex>( &expected.event);
+        const events::sysex *actual_sysex = boost::get<events::sysex>( &actual.event);
+        if (expected_sysex && actual_sysex)
+        {
+            return expected.delta_time == actual.delta_time
+                && expected_sysex->status == actual_sysex->status
+                && sysex_payload( file, expected) == sysex_payload( packed, actual);
+        }
+        return expected == actual;
+    }
+
+    bool compare( const std::string &name, const std::string &what, const midi_file &file, const packed_midi_file &packed)
+    {
+        if (!(packed.header == file.header) || packed.tracks.size() != file.tracks.size())
+        {
+            std::cerr << name << ", " << what << ": another header or number of tracks\n";
+            return false;
+        }
+        for (size_t track = 0; track != file.tracks.size(); ++track)
+        {
+            const midi_track &expected = file.tracks[track];
+            const packed_midi_track &actual = packed.tracks[track];
+            if (actual.size() != expected.size() || actual.empty() != expected.empty())
+            {
+                std::cerr << name << ", " << what << ": track " << track << " has " << actual.size() << " events instead of " << expected.size() << '\n';
+                return false;
+            }
+
+            size_t event = 0;
+            midi_track::const_iterator expected_event = expected.begin();
+            for (packed_midi_track::const_iterator actual_event = actual.begin(); actual_event != actual.end(); ++actual_event, ++expected_event, ++event)
+            {
+                // delta_time() must not depend on whether the event was unpacked.
+                const unsigned delta_time = actual_event.delta_time();
+                if (   delta_time != expected_event->delta_time
+                    || !same_event( file, *expected_event, packed, *actual_event)
+                    || actual_event->delta_time != delta_time)
+                {
+                    std::cerr << name << ", " << what << ": track " << track << " differs at event " << event << '\n';
+                    return false;
+                }
+            }
+        }
+        if (!packed.memory_usage())
+        {
+            std::cerr << name << ", " << what << ": no memory is used\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool check_file( const std::string &name, const bytes_type &bytes)
+    {
+        parse_options options( parse_options::table_backend);
+        options.capture_sysex = true;
+        midi_file file;
+        packed_midi_file decoded;
+        if (!parse_midifile( &bytes[0], bytes.size(), file, options))
+        {
+            std::cerr << name << ": can't be parsed\n";
+            return false;
+        }
+        if (!decode_packed_midifile( &bytes[0], bytes.size(), decoded))
+        {
+            std::cerr << name << ": can't be decoded into packed tracks\n";
+            return false;
+        }
+        return compare( name, "packed copy", file, packed_midi_file( file)) && compare( name, "packed decoding", file, decoded);
+    }
+
+    /// a format 1 file with a complete sysex message, a continuation packet, an empty text event, notes with running
+    /// status and a second track that holds only its end-of-track event.
+    bytes_type make_crafted_file()
+    {
+        const bytes_type first_track = {
+            0, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,
+            0, 0xf0, 0x04, 0x43, 0x12, 0x00, 0xf7,
+            10, 0xf7, 0x02, 0x01, 0x02,
+            0, 0xff, 0x01, 0x00,
+            5, 0x90, 0x3c, 0x40,
+            0, 0x3c, 0x00,
+            20, 0xf0, 0x00,
+            0, 0xff, 0x2f, 0x00};
+        const bytes_type second_track = { 0, 0xff, 0x2f, 0x00};
+
+        bytes_type result = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0, 96};
+        const bytes_type *tracks[] = { &first_track, &second_track};
+        for (size_t track = 0; track != 2; ++track)
+        {
+            result.insert( result.end(), { 'M', 'T', 'r', 'k', 0, 0, 0, static_cast<unsigned char>( tracks[track]->size())});
+            result.insert( result.end(), tracks[track]->begin(), tracks[track]->end());
+        }
+        return result;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+
+    unsigned failures = 0;
+    if (!check_file( "crafted", make_crafted_file())) ++failures;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        if (!check_file( *file, read_test_file( *file))) ++failures;
+    }
+
+    std::cout << files.size() + 1 << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Round trip test of midi snapshots: every file in the directories given on the command line is parsed with its
+/// sysex payloads and written as a snapshot. The snapshot is attached and multiplexed, which must offer the same
+/// events at the same times as multiplexing the parsed file.
+/// It also checks that damaged records unpack to empty events and that the snapshot cache notices a source file that
+/// was rewritten with the same size within the same second.
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring> // for memcpy
+#include <algorithm> // for min
+#include <filesystem>
+#include <boost/cstdint.hpp>
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_snapshot.hpp"
+#include "midilib/include/midi_writer.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    /// an event as offered by a multiplexer, with its sysex payload copied, because a sysex event of a snapshot
+    /// refers to the payload section of the snapshot instead of to the sysex_data of a midi_file.
+    struct offered_event
+    {
+        boost::uint64_t                 absolute_time;
+        unsigned                        delta_time;
+        events::midi_event              event;
+        std::vector<unsigned char>      sysex_payload;
+    };
+
+    bool operator==( const offered_event &lhs, const offered_event &rhs)
+    {
+        return lhs.absolute_time == rhs.absolute_time && lhs.delta_time == rhs.delta_time
+            && lhs.event.which() == rhs.event.which()
+            && (boost::get<events::sysex>( &lhs.event) || lhs.event == rhs.event)
+            && lhs.sysex_payload == rhs.sysex_payload;
+    }
+
+    /// visitor that records all offered events. SysexSource is a midi_file or a midi_snapshot.
+    template<typename SysexSource>
+    struct recorder
+    {
+        recorder( const SysexSource &source, std::vector<offered_event> &events)
+            : source( source), events( events)
+        {
+        }
+
+        void operator()( const events::timed_midi_event_ref &ref) const
+        {
+            offered_event offered;
+            offered.absolute_time = ref.absolute_time;
+            offered.delta_time = ref.delta_time;
+            offered.event = ref.event.event;
+            if (const events::sysex *sysex = boost::get<events::sysex>( &ref.event.event))
+            {
+                const unsigned char *bytes = source.sysex_bytes( *sysex);
+                offered.sysex_payload.assign( bytes, bytes + sysex->size);
+            }
+            events.push_back( offered);
+        }
+
+        const SysexSource           &source;
+        std::vector<offered_event>  &events;
+    };
+
+    /// a snapshot in memory, aligned on 8 bytes as midi_snapshot::attach() requires.
+    struct snapshot_buffer
+    {
+        explicit snapshot_buffer( const std::string &bytes)
+            : words( bytes.size() / 8 + 1), size( bytes.size())
+        {
+            std::memcpy( &words[0], bytes.data(), bytes.size());
+        }
+
+        unsigned char *data()
+        {
+            return reinterpret_cast<unsigned char *>( &words[0]);
+        }
+
+        std::vector<boost::uint64_t>    words;
+        size_t                          size;
+    };
+
+    std::string snapshot_bytes( const midi_file &file)
+    {
+        std::ostringstream out;
+        write_snapshot( file, out);
+        return out.str();
+    }
+
+    bool round_trip( const std::string &name, const midi_file &file)
+    {
+        snapshot_buffer buffer( snapshot_bytes( file));
+        midi_snapshot snapshot;
+        if (!snapshot.attach( buffer.data(), buffer.size))
+        {
+            std::cerr << name << ": the snapshot can't be attached\n";
+            return false;
+        }
+        if (!(snapshot.header() == file.header) || snapshot.tracks().size() != file.tracks.size())
+        {
+            std::cerr << name << ": the snapshot has another header or number of tracks\n";
+            return false;
+        }
+
+        std::vector<offered_event> expected;
+        std::vector<offered_event> actual;
+        midi_multiplexer( file.tracks).accept( recorder<midi_file>( file, expected));
+        snapshot_multiplexer( snapshot.tracks()).accept( recorder<midi_snapshot>( snapshot, actual));
+        if (expected.size() != actual.size())
+        {
+            std::cerr << name << ": the snapshot offers " << actual.size() << " events instead of " << expected.size() << '\n';
+            return false;
+        }
+        for (size_t event = 0; event != expected.size(); ++event)
+        {
+            if (!(expected[event] == actual[event]))
+            {
+                std::cerr << name << ": the snapshot differs at event " << event << '\n';
+                return false;
+            }
+        }
+
+        // a truncated snapshot must be rejected.
+        if (snapshot.attach( buffer.data(), buffer.size - 1))
+        {
+            std::cerr << name << ": a truncated snapshot is attached\n";
+            return false;
+        }
+        return true;
+    }
+
+    /// records with a status that a valid snapshot can't hold must be unpacked as empty sysex packets.
+    bool check_damaged_records( const midi_file &file)
+    {
+        snapshot_buffer buffer( snapshot_bytes( file));
+        snapshot_format::file_header header;
+        std::memcpy( &header, buffer.data(), sizeof header);
+        snapshot_format::record *records = reinterpret_cast<snapshot_format::record *>(
+            buffer.data() + sizeof header + header.track_count * sizeof( snapshot_format::track_entry));
+
+        const unsigned char invalid_status[] = { 0x00, 0x45, 0x7f, 0xf1, 0xf8, 0xfe};
+        const size_t count = std::min<size_t>( sizeof invalid_status, header.record_count);
+        for (size_t record = 0; record != count; ++record)
+        {
+            records[record].status = invalid_status[record];
+            records[record].payload_offset = 0xffffff00;
+            records[record].payload_size = 0x100;
+        }
+
+        midi_snapshot snapshot;
+        if (!snapshot.attach( buffer.data(), buffer.size))
+        {
+            std::cerr << "damaged records: the snapshot can't be attached\n";
+            return false;
+        }
+
+        size_t checked = 0;
+        for (midi_snapshot::tracks_type::const_iterator track = snapshot.tracks().begin(); track != snapshot.tracks().end() && checked != count; ++track)
+        {
+            for (snapshot_track::const_iterator event = track->begin(); event != track->end() && checked != count; ++event, ++checked)
+            {
+                const events::sysex *sysex = boost::get<events::sysex>( &event->event);
+                if (!sysex || sysex->status != 0xf7 || sysex->size != 0)
+                {
+                    std::cerr << "damaged records: status " << unsigned( invalid_status[checked]) << " is not unpacked as an empty sysex packet\n";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /// a format 0 file with a single note, the note number determines the contents but not the size.
+    void write_single_note( const std::string &path, unsigned char number)
+    {
+        midi_file file;
+        file.header.format = 0;
+        file.header.number_of_tracks = 1;
+        file.header.division = 96;
+        file.tracks.resize( 1);
+
+        events::note_on note;
+        note.number = number;
+        note.velocity = 100;
+        events::channel_event channel;
+        channel.channel = 0;
+        channel.event = note;
+        events::timed_midi_event event;
+        event.delta_time = 0;
+        event.event = channel;
+        file.tracks[0].push_back( event);
+
+        events::meta end_of_track;
+        end_of_track.type = 0x2f;
+        event.event = end_of_track;
+        file.tracks[0].push_back( event);
+
+        write_midifile( file, path);
+    }
+
+    /// the note number of the first event in the first track of a snapshot.
+    int first_note( const midi_snapshot &snapshot)
+    {
+        if (snapshot.tracks().empty() || snapshot.tracks()[0].empty()) return -1;
+        const events::channel_event *channel = boost::get<events::channel_event>( &snapshot.tracks()[0].begin()->event);
+        const events::note_on *note = channel ? boost::get<events::note_on>( &channel->event) : 0;
+        return note ? note->number : -1;
+    }
+
+    /// rewrite a cached file with the same size and a modification time less than a second later. The cache must not
+    /// offer the snapshot of the old contents.
+    bool check_cache_staleness()
+    {
+        namespace sfs = std::filesystem;
+        const sfs::path directory = sfs::temp_directory_path() / ("miditest_snapshot_" + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+        sfs::create_directories( directory);
+        const std::string source = (directory / "source.mid").string();
+
+        bool passed = true;
+        {
+            snapshot_cache cache( (directory / "cache").string());
+            midi_snapshot snapshot;
+
+            write_single_note( source, 60);
+            const sfs::file_time_type written = sfs::last_write_time( source);
+            if (!cache.open( source, snapshot) || first_note( snapshot) != 60)
+            {
+                std::cerr << "snapshot cache: the source file is not cached\n";
+                passed = false;
+            }
+            snapshot.close();
+
+            write_single_note( source, 61);
+            sfs::last_write_time( source, written + std::chrono::milliseconds( 1));
+            if (!cache.open( source, snapshot) || first_note( snapshot) != 61)
+            {
+                std::cerr << "snapshot cache: a rewritten file gets the snapshot of its old contents\n";
+                passed = false;
+            }
+        }
+
+        sfs::remove_all( directory);
+        return passed;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+    if (files.empty())
+    {
+        std::cerr << "usage: snapshot_roundtrip <directory>...\n";
+        return 1;
+    }
+
+    parse_options parse( parse_options::table_backend);
+    parse.capture_sysex = true;
+
+    unsigned failures = 0;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        midi_file original;
+        if (!parse_midifile( *file, original, parse))
+        {
+            std::cerr << *file << ": can't be parsed\n";
+            ++failures;
+            continue;
+        }
+
+        if (!round_trip( *file, original)) ++failures;
+        if (file == files.begin() && !check_damaged_records( original)) ++failures;
+    }
+
+    if (!check_cache_staleness()) ++failures;
+
+    std::cout << files.size() << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Test of the conversions between ticks and wall-clock time. Crafted files with PPQ and SMPTE time division check
+/// exact conversions across tempo changes, that microseconds_to_ticks() is the inverse of ticks_to_microseconds() and
+/// that the timed_visitor keeps the same time as the tempo_map. For every file in the directories given on the command
+/// line the inverse is checked at the times of all tempo changes.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <boost/cstdint.hpp>
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/tempo_map.hpp"
+#include "midilib/include/timed_midi_visitor.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    typedef tempo_map::tick_type tick_type;
+
+    events::timed_midi_event tempo_event( unsigned delta_time, unsigned tempo)
+    {
+        events::meta meta;
+        meta.type = 81;
+        meta.bytes.push_back( static_cast<unsigned char>( tempo >> 16));
+        meta.bytes.push_back( static_cast<unsigned char>( tempo >> 8));
+        meta.bytes.push_back( static_cast<unsigned char>( tempo));
+        events::timed_midi_event result;
+        result.delta_time = delta_time;
+        result.event = meta;
+        return result;
+    }
+
+    events::timed_midi_event note_event( unsigned delta_time)
+    {
+        events::note_on note;
+        note.number = 60;
+        note.velocity = 100;
+        events::channel_event channel;
+        channel.channel = 0;
+        channel.event = note;
+        events::timed_midi_event result;
+        result.delta_time = delta_time;
+        result.event = channel;
+        return result;
+    }
+
+    /// a file with tempo changes spread over two tracks:
+    ///  * 500000 from the start (the default, so no new segment),
+    ///  * 250000 at tick 960 (track 1),
+    ///  * 1000000 at tick 1920 (track 0),
+    ///  * 600000 in track 0 and 400000 in track 1 at tick 2880, where the later track wins.
+    /// Both tracks also hold notes, so that the timed_visitor sees events between the tempo changes.
+    midi_file make_tempo_file( unsigned division)
+    {
+        midi_file file;
+        file.header.format = 1;
+        file.header.number_of_tracks = 2;
+        file.header.division = division;
+        file.tracks.resize( 2);
+
+        file.tracks[0].push_back( tempo_event( 0, 500000));
+        file.tracks[0].push_back( note_event( 1));
+        file.tracks[0].push_back( note_event( 1000));
+        file.tracks[0].push_back( tempo_event( 919, 1000000));
+        file.tracks[0].push_back( tempo_event( 960, 600000));
+        file.tracks[0].push_back( note_event( 97));
+
+        file.tracks[1].push_back( note_event( 96));
+        file.tracks[1].push_back( tempo_event( 864, 250000));
+        file.tracks[1].push_back( note_event( 1));
+        file.tracks[1].push_back( tempo_event( 1919, 400000));
+        file.tracks[1].push_back( note_event( 500));
+        return file;
+    }
+
+    bool check( bool condition, const std::string &what)
+    {
+        if (!condition)
+        {
+            std::cerr << what << '\n';
+        }
+        return condition;
+    }
+
+    /// microseconds_to_ticks( us) must be the largest tick that is mapped to at most us. If ticks_to_microseconds() is
+    /// strictly increasing, it must also give back every tick exactly.
+    bool check_inverse( const std::string &name, const tempo_map &map, boost::uint64_t microseconds)
+    {
+        const tick_type tick = map.microseconds_to_ticks( microseconds);
+        if (map.ticks_to_microseconds( tick) > microseconds || map.ticks_to_microseconds( tick + 1) <= microseconds)
+        {
+            std::cerr << name << ": microseconds_to_ticks( " << microseconds << ") gives tick " << tick << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    bool check_inverse_range( const std::string &name, const tempo_map &map, tick_type last_tick)
+    {
+        const boost::uint64_t last = map.ticks_to_microseconds( last_tick);
+        for (boost::uint64_t microseconds = 0; microseconds <= last; microseconds += 997)
+        {
+            if (!check_inverse( name, map, microseconds)) return false;
+        }
+        for (tick_type tick = 0; tick <= last_tick; ++tick)
+        {
+            const boost::uint64_t microseconds = map.ticks_to_microseconds( tick);
+            if (   !check_inverse( name, map, microseconds)
+                || !check_inverse( name, map, microseconds + 1)
+                || (microseconds && !check_inverse( name, map, microseconds - 1)))
+            {
+                return false;
+            }
+            if (map.microseconds_to_ticks( microseconds) != tick)
+            {
+                std::cerr << name << ": tick " << tick << " doesn't survive the round trip\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// timed visitor that records the time of every event in seconds.
+    struct time_recorder : public events::timed_visitor<time_recorder>
+    {
+        typedef events::timed_visitor<time_recorder> parent;
+        using parent::operator();
+
+        explicit time_recorder( const midi_header &header)
+            : parent( header)
+        {
+        }
+
+        void operator()( const events::timed_midi_event &event)
+        {
+            parent::operator()( event);
+            times.push_back( get_current_time());
+        }
+
+        std::vector<double> times;
+    };
+
+    /// the timed_visitor must see the same times as the tempo map, apart from the rounding to whole microseconds.
+    bool check_visitor( const std::string &name, const midi_file &file, const midi_track &merged)
+    {
+        const tempo_map map( file);
+        time_recorder recorder( file.header);
+        tick_type tick = 0;
+        std::vector<double> expected;
+        for (midi_track::const_iterator event = merged.begin(); event != merged.end(); ++event)
+        {
+            recorder( *event);
+            tick += event->delta_time;
+            expected.push_back( map.ticks_to_seconds( tick));
+        }
+        for (size_t event = 0; event != expected.size(); ++event)
+        {
+            if (std::abs( recorder.times[event] - expected[event]) > 2e-6)
+            {
+                std::cerr << name << ": the timed visitor is at " << recorder.times[event] << " seconds instead of "
+                    << expected[event] << " at event " << event << '\n';
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// the events of the tempo file in the order of the multiplexer.
+    midi_track merged_tempo_track()
+    {
+        midi_track merged;
+        merged.push_back( tempo_event( 0, 500000));     // 0
+        merged.push_back( note_event( 1));              // 1
+        merged.push_back( note_event( 95));             // 96
+        merged.push_back( tempo_event( 864, 250000));   // 960
+        merged.push_back( note_event( 1));              // 961
+        merged.push_back( note_event( 40));             // 1001
+        merged.push_back( tempo_event( 919, 1000000));  // 1920
+        merged.push_back( tempo_event( 960, 600000));   // 2880
+        merged.push_back( tempo_event( 0, 400000));     // 2880
+        merged.push_back( note_event( 97));             // 2977
+        merged.push_back( note_event( 403));            // 3380
+        return merged;
+    }
+
+    bool check_ppq()
+    {
+        const midi_file file = make_tempo_file( 96);
+        const tempo_map map( file);
+        bool ok = true;
+        ok &= check( !map.is_smpte() && map.segments().size() == 4, "ppq: wrong segments");
+        ok &= check( map.tempo_at( 0) == 500000 && map.tempo_at( 959) == 500000 && map.tempo_at( 960) == 250000
+            && map.tempo_at( 1920) == 1000000 && map.tempo_at( 2879) == 1000000 && map.tempo_at( 2880) == 400000,
+            "ppq: wrong tempos");
+
+        // 500000 us per 96 ticks up to tick 960, then 250000, 1000000 and 400000 us per 96 ticks.
+        const tick_type ticks[] =              { 0, 1,    96,     960,     961,     1056,    1920,    2880,     2976,     2977};
+        const boost::uint64_t microseconds[] = { 0, 5208, 500000, 5000000, 5002604, 5250000, 7500000, 17500000, 17900000, 17904166};
+        for (size_t i = 0; i != sizeof ticks / sizeof ticks[0]; ++i)
+        {
+            if (map.ticks_to_microseconds( ticks[i]) != microseconds[i])
+            {
+                std::cerr << "ppq: tick " << ticks[i] << " is at " << map.ticks_to_microseconds( ticks[i])
+                    << " microseconds instead of " << microseconds[i] << '\n';
+                ok = false;
+            }
+        }
+        ok &= check( map.microseconds_to_ticks( 4999999) == 959 && map.microseconds_to_ticks( 5000000) == 960
+            && map.microseconds_to_ticks( 5002603) == 960 && map.microseconds_to_ticks( 5002604) == 961
+            && map.microseconds_to_ticks( 17499999) == 2879 && map.microseconds_to_ticks( 17500000) == 2880,
+            "ppq: wrong inverse at the tempo changes");
+        ok &= check( map.ticks_to_seconds( 1920) == 7.5 && map.seconds_to_ticks( 7.5) == 1920 && map.seconds_to_ticks( -1) == 0,
+            "ppq: wrong conversion in seconds");
+
+        ok &= check_inverse_range( "ppq", map, 4000);
+        ok &= check_visitor( "ppq", file, merged_tempo_track());
+
+        // a division that doesn't divide the tempos, and the header-only map.
+        const midi_file odd = make_tempo_file( 7);
+        ok &= check_inverse_range( "ppq, division 7", tempo_map( odd), 4000);
+        ok &= check_visitor( "ppq, division 7", odd, merged_tempo_track());
+        midi_header header = { 0, 1, 480};
+        const tempo_map header_map( header);
+        ok &= check( header_map.ticks_to_microseconds( 480) == 500000 && header_map.ticks_to_microseconds( 481) == 501041,
+            "ppq: wrong default tempo");
+        ok &= check_inverse_range( "ppq, header only", header_map, 2000);
+        return ok;
+    }
+
+    /// an SMPTE division for the given frames per second and ticks per frame.
+    unsigned smpte_division( unsigned fps, unsigned ticks_per_frame)
+    {
+        return ((0x100 - fps) << 8) | ticks_per_frame;
+    }
+
+    bool check_smpte()
+    {
+        bool ok = true;
+
+        // 25 fps and 40 ticks per frame: a tick is exactly one millisecond, tempo events are ignored.
+        const midi_file millisecond_file = make_tempo_file( smpte_division( 25, 40));
+        ok &= check( millisecond_file.header.division == 0xe728, "smpte: wrong division");
+        const tempo_map milliseconds( millisecond_file);
+        ok &= check( milliseconds.is_smpte() && milliseconds.segments().size() == 1 && milliseconds.tempo_at( 2880) == tempo_map::default_tempo,
+            "smpte: tempo events are not ignored");
+        ok &= check( milliseconds.ticks_to_microseconds( 1) == 1000 && milliseconds.ticks_to_microseconds( 2880) == 2880000
+            && milliseconds.microseconds_to_ticks( 999) == 0 && milliseconds.microseconds_to_ticks( 1000) == 1
+            && milliseconds.microseconds_to_ticks( 2880999) == 2880 && milliseconds.ticks_to_seconds( 1500) == 1.5,
+            "smpte: wrong conversion at 25 fps");
+        ok &= check_inverse_range( "smpte 25 fps", milliseconds, 4000);
+        ok &= check_visitor( "smpte 25 fps", millisecond_file, merged_tempo_track());
+
+        // 29.97 fps drop frame with 4 ticks per frame: 11988 ticks in 100 seconds.
+        const midi_file drop_frame_file = make_tempo_file( smpte_division( 29, 4));
+        const tempo_map drop_frame( drop_frame_file);
+        ok &= check( drop_frame.ticks_to_microseconds( 1) == 8341 && drop_frame.ticks_to_microseconds( 11988) == 100000000
+            && drop_frame.microseconds_to_ticks( 8340) == 0 && drop_frame.microseconds_to_ticks( 8341) == 1
+            && drop_frame.microseconds_to_ticks( 99999999) == 11987 && drop_frame.microseconds_to_ticks( 100000000) == 11988,
+            "smpte: wrong conversion at 29.97 fps");
+        ok &= check_inverse_range( "smpte 29.97 fps", drop_frame, 12000);
+        ok &= check_visitor( "smpte 29.97 fps", drop_frame_file, merged_tempo_track());
+
+        // 30 fps and 80 ticks per frame: 2400 ticks per second, so a tick is not a whole number of microseconds.
+        const midi_file fine_file = make_tempo_file( smpte_division( 30, 80));
+        const tempo_map fine( fine_file);
+        ok &= check( fine.ticks_to_microseconds( 3) == 1250 && fine.microseconds_to_ticks( 1249) == 2 && fine.microseconds_to_ticks( 1250) == 3,
+            "smpte: wrong conversion at 30 fps");
+        ok &= check_inverse_range( "smpte 30 fps", fine, 4000);
+        ok &= check_visitor( "smpte 30 fps", fine_file, merged_tempo_track());
+        return ok;
+    }
+
+    /// the inverse must hold around every tempo change of a real file.
+    bool check_file( const std::string &name)
+    {
+        midi_file file;
+        if (!parse_midifile( name, file, parse_options( parse_options::table_backend)))
+        {
+            std::cerr << name << ": can't be parsed\n";
+            return false;
+        }
+        const tempo_map map( file);
+        for (tempo_map::segments_type::const_iterator segment = map.segments().begin(); segment != map.segments().end(); ++segment)
+        {
+            if (map.ticks_to_microseconds( segment->tick) != segment->microseconds)
+            {
+                std::cerr << name << ": the segment at tick " << segment->tick << " doesn't start at its own time\n";
+                return false;
+            }
+            const boost::uint64_t microseconds = segment->microseconds;
+            for (boost::uint64_t around = microseconds ? microseconds - 1 : 0; around <= microseconds + 1; ++around)
+            {
+                if (!check_inverse( name, map, around)) return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+
+    unsigned failures = 0;
+    if (!check_ppq()) ++failures;
+    if (!check_smpte()) ++failures;
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        if (!check_file( *file)) ++failures;
+    }
+
+    std::cout << files.size() << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Helpers for the test executables, which take the directories with their input files on the command line.
+
+#if !defined( TEST_FILES_HPP)
+#define TEST_FILES_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm> // for sort
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+
+/// all regular files in the directories given as command line arguments, sorted by name.
+inline std::vector<std::string> test_files( int argc, char *argv[])
+{
+    namespace fs = boost::filesystem;
+
+    std::vector<std::string> result;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        for (fs::directory_iterator entry( argv[arg]); entry != fs::directory_iterator(); ++entry)
+        {
+            if (fs::is_regular_file( entry->status())) result.push_back( entry->path().string());
+        }
+    }
+    std::sort( result.begin(), result.end());
+    return result;
+}
+
+/// read a complete file into memory.
+inline std::vector<unsigned char> read_test_file( const std::string &name)
+{
+    std::ifstream stream( name.c_str(), std::ios::binary);
+    if (!stream)
+    {
+        throw std::runtime_error( "could not open " + name + " for reading");
+    }
+    return std::vector<unsigned char>( (std::istreambuf_iterator<char>( stream)), std::istreambuf_iterator<char>());
+}
+
+#endif //TEST_FILES_HPP
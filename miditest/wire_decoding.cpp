@@ -0,0 +1,204 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Behavior test of the wire decoder: running status, realtime bytes in the middle of messages, sysex messages that
+/// don't fit the sysex buffer or that are interrupted, system common messages and data bytes that must be dropped.
+/// Every case is decoded in one piece, one byte at a time and split at every possible position, and must give the
+/// same messages and the same number of dropped bytes each time.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "midilib/include/wire_decoder.hpp"
+
+namespace
+{
+    typedef std::vector<unsigned char> bytes_type;
+
+    /// handler that describes every message as a line of text.
+    struct message_log
+    {
+        void channel_event( const events::channel_event &event)
+        {
+            unsigned char status, data1, data2;
+            decoding::split_channel_event( event, status, data1, data2);
+            out << "channel " << std::hex << unsigned( status) << std::dec << ' ' << unsigned( data1);
+            if (decoding::channel_event_length[ status >> 4] == 2) out << ' ' << unsigned( data2);
+            out << '\n';
+        }
+
+        void sysex_event( const events::sysex &event, decoding::byte_iterator payload)
+        {
+            out << "sysex " << std::hex << unsigned( event.status);
+            for (unsigned i = 0; i != event.size; ++i)
+            {
+                out << ' ' << unsigned( payload[i]);
+            }
+            out << std::dec << '\n';
+        }
+
+        void system_common_event( unsigned char status, unsigned char data1, unsigned char data2)
+        {
+            out << "common " << std::hex << unsigned( status) << std::dec << ' ' << unsigned( data1) << ' ' << unsigned( data2) << '\n';
+        }
+
+        void realtime_event( unsigned char status)
+        {
+            out << "realtime " << std::hex << unsigned( status) << std::dec << '\n';
+        }
+
+        std::ostringstream out;
+    };
+
+    /// decode the input in pieces that end at the given split positions, followed by one last piece.
+    std::string decode( const bytes_type &input, const std::vector<size_t> &splits, size_t sysex_capacity, size_t &dropped)
+    {
+        message_log log;
+        decoding::wire_decoder<message_log> decoder( log, sysex_capacity);
+        const unsigned char *data = input.empty() ? 0 : &input[0];
+        size_t begin = 0;
+        for (std::vector<size_t>::const_iterator split = splits.begin(); split != splits.end(); ++split)
+        {
+            decoder.decode( data + begin, data + *split);
+            begin = *split;
+        }
+        decoder.decode( data + begin, data + input.size());
+        dropped = decoder.dropped_bytes();
+        return log.out.str();
+    }
+
+    bool check( const std::string &name, const bytes_type &input, const std::string &expected, size_t expected_dropped, size_t sysex_capacity = 1024)
+    {
+        // in one piece, one byte at a time and in two pieces split at every position.
+        std::vector<std::vector<size_t> > splittings( 1);
+        std::vector<size_t> bytes;
+        for (size_t position = 1; position < input.size(); ++position)
+        {
+            bytes.push_back( position);
+            splittings.push_back( std::vector<size_t>( 1, position));
+        }
+        splittings.push_back( bytes);
+
+        for (size_t splitting = 0; splitting != splittings.size(); ++splitting)
+        {
+            size_t dropped = 0;
+            const std::string messages = decode( input, splittings[splitting], sysex_capacity, dropped);
+            if (messages != expected || dropped != expected_dropped)
+            {
+                std::cerr << name << ": split in " << splittings[splitting].size() + 1 << " pieces, " << dropped
+                    << " bytes dropped instead of " << expected_dropped << ", the messages are\n" << messages
+                    << "instead of\n" << expected;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    unsigned failures = 0;
+    unsigned cases = 0;
+
+    ++cases;
+    if (!check( "running status",
+        { 0x90, 60, 100, 61, 101, 62, 0, 0xc3, 5, 6},
+        "channel 90 60 100\n"
+        "channel 90 61 101\n"
+        "channel 90 62 0\n"
+        "channel c3 5\n"
+        "channel c3 6\n",
+        0)) ++failures;
+
+    ++cases;
+    if (!check( "realtime in the middle of messages",
+        { 0x90, 0xf8, 60, 0xfe, 100, 61, 0xfa, 101, 0xf0, 1, 0xf8, 2, 0xf7},
+        "realtime f8\n"
+        "realtime fe\n"
+        "channel 90 60 100\n"
+        "realtime fa\n"
+        "channel 90 61 101\n"
+        "realtime f8\n"
+        "sysex f0 1 2 f7\n",
+        0)) ++failures;
+
+    ++cases;
+    if (!check( "sysex longer than the buffer",
+        { 0xf0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0xf7, 0x90, 60, 100},
+        "sysex f0 1 2 3 4\n"
+        "sysex f7 5 6 7 8\n"
+        "sysex f7 9 a f7\n"
+        "channel 90 60 100\n",
+        0, 4)) ++failures;
+
+    ++cases;
+    if (!check( "sysex that fills the buffer exactly",
+        { 0xf0, 1, 2, 3, 4, 0xf7},
+        "sysex f0 1 2 3 4\n"
+        "sysex f7 f7\n",
+        0, 4)) ++failures;
+
+    ++cases;
+    if (!check( "sysex interrupted by a status byte",
+        { 0xf0, 1, 2, 0x90, 60, 100, 0xf0, 3, 0xf2, 4, 5},
+        "sysex f0 1 2\n"
+        "channel 90 60 100\n"
+        "sysex f0 3\n"
+        "common f2 4 5\n",
+        0)) ++failures;
+
+    ++cases;
+    if (!check( "tune request",
+        { 0x90, 60, 100, 0xf6, 1, 2, 0x80, 60, 64},
+        "channel 90 60 100\n"
+        "common f6 0 0\n"
+        "channel 80 60 64\n",
+        2)) ++failures;
+
+    ++cases;
+    if (!check( "data bytes after system common messages",
+        { 0xf2, 1, 2, 3, 4, 0xf1, 5, 6, 0xf3, 7, 0xf5, 8, 0xf0, 9, 0xf7, 10},
+        "common f2 1 2\n"
+        "common f1 5 0\n"
+        "common f3 7 0\n"
+        "sysex f0 9 f7\n",
+        5)) ++failures;
+
+    ++cases;
+    if (!check( "starting in the middle of a message",
+        { 60, 100, 0xb0, 7, 100},
+        "channel b0 7 100\n",
+        2)) ++failures;
+
+    ++cases;
+    if (!check( "channel message interrupted by another status",
+        { 0x90, 60, 0xb0, 7, 100, 0x90, 0xf1},
+        "channel b0 7 100\n",
+        1)) ++failures;
+
+    // reset forgets the running status and a partial message.
+    ++cases;
+    {
+        message_log log;
+        decoding::wire_decoder<message_log> decoder( log);
+        const unsigned char before[] = { 0x90, 60, 100, 61};
+        const unsigned char after[] = { 100, 62, 100};
+        decoder.decode( before, before + sizeof before);
+        decoder.reset();
+        decoder.decode( after, after + sizeof after);
+        if (log.out.str() != "channel 90 60 100\n" || decoder.dropped_bytes() != 3)
+        {
+            std::cerr << "reset: the messages are\n" << log.out.str() << decoder.dropped_bytes() << " bytes dropped\n";
+            ++failures;
+        }
+    }
+
+    std::cout << cases << " cases, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
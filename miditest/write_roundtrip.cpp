@@ -0,0 +1,218 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Round trip test of the midi file writer: every file in the directories given on the command line is parsed with
+/// its sysex payloads, written, and parsed again, with and without running status. Both parses must build identical
+/// midi_file structures.
+/// It also checks that the largest channel event values are written as they are and that values that are out of range,
+/// e.g. after transposing, are rejected.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm> // for equal
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_writer.hpp"
+#include "test_files.hpp"
+
+namespace
+{
+    bool round_trip( const std::string &name, const midi_file &original, const write_options &write, const parse_options &parse)
+    {
+        std::vector<unsigned char> buffer;
+        write_midifile( original, buffer, write);
+
+        midi_file copy;
+        if (!parse_midifile( &buffer[0], buffer.size(), copy, parse))
+        {
+            std::cerr << name << ": the written file can't be parsed\n";
+            return false;
+        }
+        if (!(copy == original))
+        {
+            std::cerr << name << ": the written file differs from the original\n";
+            return false;
+        }
+        return true;
+    }
+
+    events::timed_midi_event channel_event( unsigned char channel, const events::channel_event_variant &event)
+    {
+        events::timed_midi_event result;
+        result.delta_time = 0;
+        events::channel_event channel_event;
+        channel_event.channel = channel;
+        channel_event.event = event;
+        result.event = channel_event;
+        return result;
+    }
+
+    /// a file with a single track that holds the given channel event and an end-of-track event.
+    midi_file single_event_file( const events::timed_midi_event &event)
+    {
+        midi_file result;
+        result.header.format = 0;
+        result.header.number_of_tracks = 1;
+        result.header.division = 96;
+        result.tracks.resize( 1);
+        result.tracks[0].push_back( event);
+        events::timed_midi_event end_of_track;
+        end_of_track.delta_time = 0;
+        events::meta meta;
+        meta.type = 0x2f;
+        end_of_track.event = meta;
+        result.tracks[0].push_back( end_of_track);
+        return result;
+    }
+
+    /// the largest values that fit must be written exactly as they are.
+    bool check_largest_values()
+    {
+        events::note_on note;
+        note.number = 127;
+        note.velocity = 127;
+        events::controller controller;
+        controller.which = 127;
+        controller.value = 127;
+
+        midi_file file = single_event_file( channel_event( 15, note));
+        file.tracks[0].insert( file.tracks[0].end() - 1, channel_event( 15, controller));
+        file.tracks[0].insert( file.tracks[0].end() - 1, channel_event( 15, events::program_change( 127)));
+        file.tracks[0].insert( file.tracks[0].end() - 1, channel_event( 15, events::pitch_bend( 0x7f7f)));
+
+        const unsigned char expected[] = {
+            0, 0x9f, 127, 127,
+            0, 0xbf, 127, 127,
+            0, 0xcf, 127,
+            0, 0xef, 0x7f, 0x7f,
+            0, 0xff, 0x2f, 0};
+
+        std::vector<unsigned char> buffer;
+        write_midifile( file, buffer);
+        const size_t track_begin = 14 + 8;
+        if (   buffer.size() != track_begin + sizeof expected
+            || !std::equal( expected, expected + sizeof expected, buffer.begin() + track_begin))
+        {
+            std::cerr << "the largest channel event values are not written as they are\n";
+            return false;
+        }
+        return true;
+    }
+
+    /// writing the given file must throw std::out_of_range and leave the output buffer untouched.
+    bool check_rejected( const std::string &name, const midi_file &file)
+    {
+        std::vector<unsigned char> buffer( 1, 0x55);
+        try
+        {
+            midifile_size( file);
+            std::cerr << name << ": midifile_size accepts an out of range value\n";
+            return false;
+        }
+        catch (const std::out_of_range &)
+        {
+        }
+        try
+        {
+            write_midifile( file, buffer);
+            std::cerr << name << ": write_midifile accepts an out of range value\n";
+            return false;
+        }
+        catch (const std::out_of_range &)
+        {
+        }
+        if (buffer.size() != 1 || buffer[0] != 0x55)
+        {
+            std::cerr << name << ": the output buffer was changed\n";
+            return false;
+        }
+        return true;
+    }
+
+    /// channel event values that don't fit in a data byte must be rejected, not written as other values.
+    bool check_out_of_range_values()
+    {
+        events::note_on note;
+        note.number = 130;
+        note.velocity = 100;
+        events::controller controller;
+        controller.which = 7;
+        controller.value = 200;
+        events::note_on valid_note;
+        valid_note.number = 60;
+        valid_note.velocity = 100;
+
+        return check_rejected( "note number 130", single_event_file( channel_event( 0, note)))
+            && check_rejected( "controller value 200", single_event_file( channel_event( 0, controller)))
+            && check_rejected( "pitch bend 0x0080", single_event_file( channel_event( 0, events::pitch_bend( 0x0080))))
+            && check_rejected( "channel 16", single_event_file( channel_event( 16, valid_note)));
+    }
+
+    /// transpose all notes of a file above the range of note numbers. The writer must refuse it.
+    bool check_transposed( const std::string &name, const midi_file &original)
+    {
+        midi_file transposed( original);
+        bool has_notes = false;
+        for (midi_file::tracks_type::iterator track = transposed.tracks.begin(); track != transposed.tracks.end(); ++track)
+        {
+            for (midi_track::iterator event = track->begin(); event != track->end(); ++event)
+            {
+                events::channel_event *channel = boost::get<events::channel_event>( &event->event);
+                events::note_on *note = channel ? boost::get<events::note_on>( &channel->event) : 0;
+                if (note)
+                {
+                    note->number = static_cast<unsigned char>( note->number + 128);
+                    has_notes = true;
+                }
+            }
+        }
+        return !has_notes || check_rejected( name + " (transposed)", transposed);
+    }
+}
+
+int main( int argc, char *argv[])
+{
+    const std::vector<std::string> files = test_files( argc, argv);
+    if (files.empty())
+    {
+        std::cerr << "usage: write_roundtrip <directory>...\n";
+        return 1;
+    }
+
+    parse_options parse( parse_options::table_backend);
+    parse.capture_sysex = true;
+
+    write_options without_running_status;
+    without_running_status.running_status = false;
+
+    unsigned failures = 0;
+    if (!check_largest_values()) ++failures;
+    if (!check_out_of_range_values()) ++failures;
+
+    for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+    {
+        midi_file original;
+        if (!parse_midifile( *file, original, parse))
+        {
+            std::cerr << *file << ": can't be parsed\n";
+            ++failures;
+            continue;
+        }
+
+        if (   !round_trip( *file, original, write_options(), parse)
+            || !round_trip( *file, original, without_running_status, parse)
+            || !check_transposed( *file, original))
+        {
+            ++failures;
+        }
+    }
+
+    std::cout << files.size() << " files, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>    // for unique_ptr
+#include <algorithm> // for transform, min, max
+#include <cctype>    // for tolower
+#include <cstdio>    // for snprintf
+
+#include <boost/filesystem.hpp>
+
+#include "midilib/include/midi_parser.hpp"
+#include "midilib/include/midi_multiplexer.hpp"
+#include "midilib/include/midi_snapshot.hpp"
+#include "print_text_visitor.hpp"
+#include "batch_mode.hpp"
+
+namespace
+{
+    namespace fs = boost::filesystem;
+
+    /// The outcome of processing a single file.
+    struct file_result
+    {
+        file_result()
+            : done( false), parsed( false), size( 0)
+        {
+        }
+
+        bool            done;
+        bool            parsed;
+        boost::uintmax_t size;
+        std::string     output; ///< the lyrics or an error message
+    };
+
+    bool is_midi_file( const fs::path &path)
+    {
+        std::string extension = path.extension().string();
+        std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".mid" || extension == ".midi" || extension == ".kar";
+    }
+
+    /// add 'path' to the list of files. Directories are searched recursively for midi files.
+    void collect_files( const std::string &path, std::vector<std::string> &files)
+    {
+        boost::system::error_code error;
+        if (fs::is_directory( path, error))
+        {
+            std::vector<std::string> found;
+            for (fs::recursive_directory_iterator i( path, error), end; i != end; i.increment( error))
+            {
+                if (error) break;
+                if (fs::is_regular_file( i->status()) && is_midi_file( i->path()))
+                {
+                    found.push_back( i->path().string());
+                }
+            }
+
+            // directory iteration order is unspecified, sort to get deterministic output.
+            std::sort( found.begin(), found.end());
+            files.insert( files.end(), found.begin(), found.end());
+        }
+        else
+        {
+            files.push_back( path);
+        }
+    }
+
+    std::string json_escape( const std::string &text)
+    {
+        std::string result;
+        result.reserve( text.size() + 2);
+        for (std::string::const_iterator i = text.begin(); i != text.end(); ++i)
+        {
+            const unsigned char c = *i;
+            switch (c)
+            {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20 || c >= 0x80)
+                {
+                    // midi texts have no defined encoding, so anything that is not plain ascii is escaped as latin-1.
+                    char escaped[8];
+                    std::snprintf( escaped, sizeof escaped, "\\u%04x", c);
+                    result += escaped;
+                }
+                else
+                {
+                    result += static_cast<char>( c);
+                }
+            }
+        }
+        return result;
+    }
+
+    void write_result( std::ostream &out, const std::string &filename, const file_result &result, bool json_lines)
+    {
+        if (json_lines)
+        {
+            out << "{\"file\":\"" << json_escape( filename) << "\",\"ok\":" << (result.parsed ? "true" : "false");
+            out << (result.parsed ? ",\"lyrics\":\"" : ",\"error\":\"") << json_escape( result.output) << "\"}\n";
+        }
+        else
+        {
+            out << "== " << filename << '\n';
+            if (result.parsed)
+            {
+                out << result.output << '\n';
+            }
+            else
+            {
+                out << "error: " << result.output << '\n';
+            }
+        }
+    }
+
+    /// State that is shared by all workers.
+    /// Workers take the next unprocessed file from a shared counter, which balances the load without any queue.
+    /// Results are written by whichever worker completes the next file in input order, so that the output order
+    /// does not depend on scheduling.
+    class batch
+    {
+    public:
+        batch( const std::vector<std::string> &files, bool json_lines, const snapshot_cache *cache)
+            : files( files), results( files.size()), json_lines( json_lines), cache( cache), next_file( 0), next_output( 0)
+        {
+        }
+
+        /// process files until all files have been taken.
+        /// The midi_file and the output buffer are reused for all files this worker processes.
+        void work()
+        {
+            midi_file midi;
+            std::ostringstream output;
+            parse_options options( parse_options::table_backend);
+            options.filter = event_filter::meta_only();
+            options.limits = decode_limits::untrusted();
+
+            for (size_t index = next_file++; index < files.size(); index = next_file++)
+            {
+                file_result result;
+                output.str( std::string());
+                try
+                {
+                    boost::system::error_code error;
+                    result.size = fs::file_size( files[index], error);
+                    if (error) result.size = 0;
+
+                    if (cache)
+                    {
+                        // a snapshot that is up to date is mapped without parsing the file.
+                        midi_snapshot snapshot;
+                        result.parsed = cache->open( files[index], snapshot);
+                        if (result.parsed)
+                        {
+                            snapshot_multiplexer multiplexer( snapshot.tracks());
+                            multiplexer.accept( print_text_visitor( output, snapshot.header()));
+                        }
+                    }
+                    else
+                    {
+                        result.parsed = parse_midifile( files[index], midi, options);
+                        if (result.parsed)
+                        {
+                            midi_multiplexer multiplexer( midi.tracks);
+                            multiplexer.accept( print_text_visitor( output, midi.header));
+                        }
+                    }
+
+                    if (result.parsed)
+                    {
+                        result.output = output.str();
+                    }
+                    else
+                    {
+                        result.output = "can't parse as a valid midi file";
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    result.parsed = false;
+                    result.output = e.what();
+                }
+                complete( index, result);
+            }
+        }
+
+        /// write the summary of a completed batch
+        void summarize( std::ostream &out, double seconds) const
+        {
+            boost::uintmax_t bytes = 0;
+            for (std::vector<file_result>::const_iterator i = results.begin(); i != results.end(); ++i)
+            {
+                bytes += i->size;
+            }
+
+            seconds = std::max( seconds, 1e-9);
+            out << "files: " << files.size()
+                << ", failures: " << failures()
+                << ", seconds: " << seconds
+                << ", files/s: " << files.size() / seconds
+                << ", MB/s: " << bytes / seconds / (1024 * 1024)
+                << '\n';
+        }
+
+        size_t failures() const
+        {
+            size_t count = 0;
+            for (std::vector<file_result>::const_iterator i = results.begin(); i != results.end(); ++i)
+            {
+                if (!i->parsed) ++count;
+            }
+            return count;
+        }
+
+    private:
+        /// store the result for a file and write all results that are now complete in input order.
+        void complete( size_t index, file_result &result)
+        {
+            std::lock_guard<std::mutex> lock( output_mutex);
+            results[index] = result;
+            results[index].done = true;
+            while (next_output < results.size() && results[next_output].done)
+            {
+                write_result( std::cout, files[next_output], results[next_output], json_lines);
+
+                // the output isn't needed anymore, only the statistics.
+                std::string().swap( results[next_output].output);
+                ++next_output;
+            }
+        }
+
+        const std::vector<std::string> &files;
+        std::vector<file_result>        results;
+        const bool                      json_lines;
+        const snapshot_cache            *cache;
+        std::atomic<size_t>             next_file;
+        size_t                          next_output;
+        std::mutex                      output_mutex;
+    };
+}
+
+int run_batch( const batch_options &options)
+{
+    std::vector<std::string> files;
+    if (options.paths.empty())
+    {
+        std::string line;
+        while (std::getline( std::cin, line))
+        {
+            if (!line.empty()) collect_files( line, files);
+        }
+    }
+    else
+    {
+        for (std::vector<std::string>::const_iterator i = options.paths.begin(); i != options.paths.end(); ++i)
+        {
+            collect_files( *i, files);
+        }
+    }
+
+    unsigned jobs = options.jobs ? options.jobs : std::max( 1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>( std::max<size_t>( 1, std::min<size_t>( jobs, files.size())));
+
+    typedef std::chrono::steady_clock clock_type;
+    const clock_type::time_point start = clock_type::now();
+
+    std::unique_ptr<snapshot_cache> cache;
+    if (!options.cache.empty())
+    {
+        cache.reset( new snapshot_cache( options.cache, decode_limits::untrusted()));
+    }
+
+    batch work( files, options.json_lines, cache.get());
+    std::vector<std::thread> workers;
+    for (unsigned job = 1; job < jobs; ++job)
+    {
+        workers.push_back( std::thread( &batch::work, &work));
+    }
+    work.work();
+    for (std::vector<std::thread>::iterator i = workers.begin(); i != workers.end(); ++i)
+    {
+        i->join();
+    }
+    std::cout.flush();
+
+    work.summarize( std::cerr, std::chrono::duration<double>( clock_type::now() - start).count());
+
+    return work.failures() ? 1 : 0;
+}
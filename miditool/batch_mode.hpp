@@ -0,0 +1,33 @@
+//
+//  Copyright (C) 2012 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( BATCH_MODE_HPP)
+#define BATCH_MODE_HPP
+#include <string>
+#include <vector>
+
+/// Options for processing many midi files in one run.
+struct batch_options
+{
+    batch_options()
+        : jobs( 0), json_lines( false)
+    {
+    }
+
+    unsigned                    jobs;       ///< number of worker threads, zero means one per hardware thread.
+    bool                        json_lines; ///< write one json object per file instead of plain text.
+    std::vector<std::string>    paths;      ///< files and directories to process. If empty, paths are read from stdin.
+    std::string                 cache;      ///< directory for snapshots of parsed files, no snapshots are used if empty.
+};
+
+/// Extract the lyrics of all files given in the options, using a pool of worker threads.
+/// Results are written to stdout in the order of the input files, a throughput summary is written to stderr.
+/// Returns the exit code for the application: zero if all files could be processed.
+int run_batch( const batch_options &options);
+
+#endif //BATCH_MODE_HPP
@@ -9,77 +9,119 @@
 #include <iostream>
 #include <fstream>
 #include <exception>
-#include <iomanip> // for setiosflags, setw
+#include <cstdlib> // for atoi
+#include <cstring> // for strcmp
 
 #include "midilib/include/midi_parser.hpp"
 #include "midilib/include/midi_multiplexer.hpp"
-#include "midilib/include/timed_midi_visitor.hpp"
-///
-/// This class only reacts on meta events. If the meta event is of type "text" (0x01)
-/// then it will print the data of the event to the given output stream.
-/// backward- and forward slashes will be converted to newlines.
-/// texts that start with @ will be ignored.
-///
-struct print_text_visitor: public events::timed_visitor<print_text_visitor>
+#include "midilib/include/midi_player.hpp"
+#include "print_text_visitor.hpp"
+#include "batch_mode.hpp"
+
+namespace
 {
-    typedef events::timed_visitor< print_text_visitor> parent;
-    using parent::operator();
+    /// play a file in real time to stdout.
+    int play( const std::string &filename)
+    {
+        midi_file midi;
+        if (!parse_midifile( filename, midi))
+        {
+            std::cerr << "I can't parse " << filename << " as a valid midi file\n";
+            return -1;
+        }
 
-    print_text_visitor( std::ostream &output, midi_header &header)
-        : output(output), parent( header)
+        midi_player player( midi);
+        stream_sink sink( std::cout);
+        const playback_statistics statistics = player.play( sink);
+        std::cout.flush();
+
+        std::cerr << "events: " << statistics.events
+            << ", batches: " << statistics.batches
+            << ", late events: " << statistics.late_events
+            << ", max lateness (us): " << statistics.max_lateness
+            << ", mean jitter (us): " << statistics.mean_jitter()
+            << ", max jitter (us): " << statistics.max_jitter
+            << '\n';
+        return statistics.late_events ? 1 : 0;
+    }
+
+    void usage()
     {
+        std::cerr <<
+            "usage: miditool <midi file name | ->\n"
+            "       miditool --batch [--jobs <n>] [--json] [--cache <directory>] [<file or directory>...]\n"
+            "       miditool --play <midi file name>\n"
+            "\n"
+            "In batch mode, the lyrics of all given files are extracted, directories are searched recursively\n"
+            "for .mid, .midi and .kar files. Without file names, the names are read from stdin, one per line.\n"
+            "With --cache, snapshots of the parsed files are kept in the given directory, so that files are\n"
+            "only parsed again when they change.\n"
+            "With --play, the events of a file are written to stdout in real time and timing statistics are\n"
+            "written to stderr.\n";
+        exit( -1);
     }
+}
 
-    void operator()( const events::meta &event)
+int main( int argc, char *argv[])
+{
+    using namespace std;
+    if (argc >= 2 && strcmp( argv[1], "--batch") == 0)
     {
-        using namespace std;
-        // is it a text event?
-        // we're ignoring lyrics (0x05) events, because text events have more
-        // information (like 'start of new line')
-        if (event.type == 0x01)
+        batch_options options;
+        for (int arg = 2; arg < argc; ++arg)
         {
-            string event_text( event.bytes.begin(), event.bytes.end());
-            if (event_text.size() > 0 && event_text[0] != '@')
+            if (strcmp( argv[arg], "--jobs") == 0 && arg + 1 < argc)
+            {
+                options.jobs = atoi( argv[++arg]);
+            }
+            else if (strcmp( argv[arg], "--cache") == 0 && arg + 1 < argc)
+            {
+                options.cache = argv[++arg];
+            }
+            else if (strcmp( argv[arg], "--json") == 0)
             {
-                if (event_text[0] == '/' || event_text[0] == '\\')
-                {
-                    output << "\n" << setiosflags( ios::right) << setprecision(2) << fixed << setw( 6) << get_current_time() << '\t';
-                    output << event_text.substr( 1);
-                }
-                else
-                {
-                    output << event_text;
-                }
+                options.json_lines = true;
+            }
+            else
+            {
+                options.paths.push_back( argv[arg]);
             }
         }
+        return run_batch( options);
     }
 
+    if (argc == 3 && strcmp( argv[1], "--play") == 0)
+    {
+        try
+        {
+            return play( argv[2]);
+        }
+        catch (const exception &e)
+        {
+            cerr << "something went wrong: " << e.what() << '\n';
+            return -1;
+        }
+    }
 
-private:
-    std::ostream &output;
-};
-
-int main( int argc, char *argv[])
-{
-    using namespace std;
     if (argc != 2)
     {
-        cerr << "usage: miditool <midi file name>\n";
-        exit( -1);
+        usage();
     }
 
     try
     {
         string filename( argv[1]);
-        ifstream inputfile( filename.c_str(), ios::binary);
-        if (!inputfile)
-        {
-            throw runtime_error( "could not open " + filename + " for reading");
-        }
+        midi_file midi;
 
+        // only the text events are printed, so there's no need to build the channel events.
+        parse_options options;
+        options.filter = event_filter::meta_only();
 
-        midi_file midi;
-        if (!parse_midifile( inputfile, midi))
+        // a file name of "-" means: read from stdin. Regular files are memory mapped.
+        const bool parsed = (filename == "-")
+            ? parse_midifile( cin, midi, options)
+            : parse_midifile( filename, midi, options);
+        if (!parsed)
         {
             throw runtime_error( "I can't parse " + filename + " as a valid midi file");
         }